@@ -0,0 +1,42 @@
+//
+//  AppleSystemInfoPatches.hpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef AppleSystemInfoPatches_h
+#define AppleSystemInfoPatches_h
+
+#include <Headers/kern_api.hpp>
+
+static constexpr char binPathAppleSystemInfo[] = "/System/Library/PrivateFrameworks/AppleSystemInfo.framework/Versions/A/AppleSystemInfo";
+
+/**
+ *  Model whitelist hiding the memory tab
+ */
+static constexpr char memFindPatch[] = "MacBookAir\0MacBookPro10";
+static constexpr char memReplPatch[] = "HacBookAir\0HacBookPro10";
+
+/**
+ *  CPU names replaced by the brand string, starting with the terminator of the preceding string
+ */
+static constexpr char cpuNameCoreI5[] = "\0" "Intel Core i5";
+static constexpr char cpuNameDualCoreI5[] = "\0" "Dual-Core Intel Core i5";
+static constexpr char cpuNameQuadCoreI5[] = "\0" "Quad-Core Intel Core i5";
+static constexpr char cpuName6CoreI5[] = "\0" "6-Core Intel Core i5";
+static constexpr char cpuName8CoreXeonW[] = "\0" "8-Core Intel Xeon W";
+static constexpr char cpuName10CoreXeonW[] = "\0" "10-Core Intel Xeon W";
+static constexpr char cpuName12CoreXeonW[] = "\0" "12-Core Intel Xeon W";
+static constexpr char cpuName14CoreXeonW[] = "\0" "14-Core Intel Xeon W";
+static constexpr char cpuName16CoreXeonW[] = "\0" "16-Core Intel Xeon W";
+static constexpr char cpuName18CoreXeonW[] = "\0" "18-Core Intel Xeon W";
+static constexpr char cpuName24CoreXeonW[] = "\0" "24-Core Intel Xeon W";
+static constexpr char cpuName28CoreXeonW[] = "\0" "28-Core Intel Xeon W";
+
+/**
+ *  Core count table entry of the 28-core Xeon W, the core count byte is at offset 16
+ */
+static constexpr uint8_t findUnlockCoreCount[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+#endif /* AppleSystemInfoPatches_h */
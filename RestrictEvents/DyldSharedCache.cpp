@@ -0,0 +1,223 @@
+//
+//  DyldSharedCache.cpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <string.h>
+
+#include "DyldSharedCache.hpp"
+
+//
+// Field offsets from dyld_cache_header in dyld's dyld_cache_format.h.
+// Newer fields are only present when mappingOffset, which follows the header, is past them.
+//
+static constexpr size_t CacheMagicSize             = 16;
+static constexpr size_t CacheMappingOffset         = 0x10;
+static constexpr size_t CacheMappingCount          = 0x14;
+static constexpr size_t CacheImagesOffsetOld       = 0x18;
+static constexpr size_t CacheImagesCountOld        = 0x1C;
+static constexpr size_t CacheSubCacheArrayOffset   = 0x188;
+static constexpr size_t CacheSubCacheArrayCount    = 0x18C;
+static constexpr size_t CacheImagesOffset          = 0x1C0;
+static constexpr size_t CacheImagesCount           = 0x1C4;
+static constexpr size_t CacheSubType               = 0x1C8;
+static constexpr size_t CacheHeaderReadSize        = 0x200;
+
+static constexpr size_t MappingInfoSize            = 32;
+static constexpr size_t ImageInfoPathOffset        = 24;
+static constexpr size_t SubCacheEntryV2Size        = 56;
+static constexpr size_t SubCacheEntryV2Suffix      = 24;
+
+static constexpr uint32_t MachHeader64Magic        = 0xFEEDFACF;
+static constexpr size_t MachHeader64Size           = 32;
+static constexpr uint32_t LoadCommandSegment64     = 0x19;
+static constexpr size_t SegmentCommand64MinSize    = 72;
+
+static constexpr size_t MaxImagePath               = 256;
+static_assert(MaxImagePath <= DyldSharedCache::PathWindowSize, "Image path must fit the path window");
+
+template <typename T>
+static T readValue(const uint8_t *buffer, size_t offset) {
+	T value;
+	memcpy(&value, buffer + offset, sizeof(value));
+	return value;
+}
+
+bool DyldSharedCache::parseHeader(Reader reader, void *context, Header &header) {
+	uint8_t buffer[CacheHeaderReadSize];
+	if (!reader(context, 0, buffer, sizeof(buffer)) || memcmp(buffer, "dyld_v1 ", 8) != 0)
+		return false;
+
+	memset(&header, 0, sizeof(header));
+	auto mappingOffset = readValue<uint32_t>(buffer, CacheMappingOffset);
+	auto mappingCount  = readValue<uint32_t>(buffer, CacheMappingCount);
+	if (mappingOffset < CacheImagesCountOld + sizeof(uint32_t) || mappingCount == 0 || mappingCount > MaxMappings)
+		return false;
+
+	if (mappingOffset >= CacheImagesCount + sizeof(uint32_t)) {
+		header.imagesOffset = readValue<uint32_t>(buffer, CacheImagesOffset);
+		header.imagesCount  = readValue<uint32_t>(buffer, CacheImagesCount);
+	} else {
+		header.imagesOffset = readValue<uint32_t>(buffer, CacheImagesOffsetOld);
+		header.imagesCount  = readValue<uint32_t>(buffer, CacheImagesCountOld);
+	}
+
+	if (mappingOffset >= CacheSubCacheArrayCount + sizeof(uint32_t)) {
+		header.subCacheOffset   = readValue<uint32_t>(buffer, CacheSubCacheArrayOffset);
+		header.subCacheCount    = readValue<uint32_t>(buffer, CacheSubCacheArrayCount);
+		header.subCacheSuffixes = mappingOffset > CacheSubType;
+	}
+
+	uint8_t mappings[MaxMappings * MappingInfoSize];
+	if (!reader(context, mappingOffset, mappings, mappingCount * MappingInfoSize))
+		return false;
+
+	header.mappingCount = mappingCount;
+	for (size_t i = 0; i < mappingCount; i++) {
+		header.mappings[i].address    = readValue<uint64_t>(mappings, i * MappingInfoSize);
+		header.mappings[i].size       = readValue<uint64_t>(mappings, i * MappingInfoSize + 8);
+		header.mappings[i].fileOffset = readValue<uint64_t>(mappings, i * MappingInfoSize + 16);
+	}
+
+	return true;
+}
+
+bool DyldSharedCache::findImage(Reader reader, void *context, const Header &header, const char *path, uint64_t &address, ImageScan &scan) {
+	size_t pathSize = strlen(path) + 1;
+	if (pathSize > MaxImagePath)
+		return false;
+
+	// Image paths follow the image list mostly in the same order, so each window read covers many of them.
+	uint64_t windowStart = 0;
+	uint64_t windowEnd = 0;
+	for (uint32_t start = 0; start < header.imagesCount; start += ImageBatch) {
+		uint32_t count = header.imagesCount - start < ImageBatch ? header.imagesCount - start : ImageBatch;
+		if (!reader(context, header.imagesOffset + static_cast<uint64_t>(start) * ImageInfoSize, scan.images, count * ImageInfoSize))
+			return false;
+
+		for (uint32_t i = 0; i < count; i++) {
+			uint64_t pathOffset = readValue<uint32_t>(scan.images, i * ImageInfoSize + ImageInfoPathOffset);
+			if (pathOffset < windowStart || pathOffset + pathSize > windowEnd) {
+				if (reader(context, pathOffset, scan.paths, PathWindowSize)) {
+					windowEnd = pathOffset + PathWindowSize;
+				} else if (reader(context, pathOffset, scan.paths, pathSize)) {
+					// The window may not fit before the end of the file.
+					windowEnd = pathOffset + pathSize;
+				} else {
+					windowEnd = 0;
+					continue;
+				}
+				windowStart = pathOffset;
+			}
+
+			if (memcmp(&scan.paths[pathOffset - windowStart], path, pathSize) == 0) {
+				address = readValue<uint64_t>(scan.images, i * ImageInfoSize);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool DyldSharedCache::fileOffset(const Header &header, uint64_t address, uint64_t &offset) {
+	for (size_t i = 0; i < header.mappingCount; i++) {
+		auto &mapping = header.mappings[i];
+		if (address >= mapping.address && address - mapping.address < mapping.size) {
+			offset = address - mapping.address + mapping.fileOffset;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool DyldSharedCache::readSegments(Reader reader, void *context, const Header &header, uint64_t address, Range *segments, size_t &count) {
+	uint64_t offset = 0;
+	if (!fileOffset(header, address, offset))
+		return false;
+
+	// Load commands are read one by one to keep the stack usage low in the kernel.
+	uint8_t buffer[SegmentCommand64MinSize];
+	if (!reader(context, offset, buffer, MachHeader64Size) || readValue<uint32_t>(buffer, 0) != MachHeader64Magic)
+		return false;
+
+	auto commandCount = readValue<uint32_t>(buffer, 16);
+	auto commandsSize = readValue<uint32_t>(buffer, 20);
+
+	count = 0;
+	uint32_t position = 0;
+	for (uint32_t i = 0; i < commandCount; i++) {
+		if (commandsSize - position < 2 * sizeof(uint32_t) ||
+			!reader(context, offset + MachHeader64Size + position, buffer, 2 * sizeof(uint32_t)))
+			return false;
+		auto command = readValue<uint32_t>(buffer, 0);
+		auto commandSize = readValue<uint32_t>(buffer, sizeof(uint32_t));
+		if (commandSize < 2 * sizeof(uint32_t) || commandSize > commandsSize - position)
+			return false;
+
+		if (command == LoadCommandSegment64 && commandSize >= SegmentCommand64MinSize) {
+			if (!reader(context, offset + MachHeader64Size + position, buffer, SegmentCommand64MinSize))
+				return false;
+			auto vmaddr = readValue<uint64_t>(buffer, 24);
+			auto vmsize = readValue<uint64_t>(buffer, 32);
+			if (vmsize > 0 && strncmp(reinterpret_cast<const char *>(&buffer[8]), "__LINKEDIT", 16) != 0) {
+				if (count >= MaxSegments)
+					return false;
+				segments[count].start = vmaddr;
+				segments[count].end = vmaddr + vmsize;
+				count++;
+			}
+		}
+
+		position += commandSize;
+	}
+
+	return count > 0;
+}
+
+void DyldSharedCache::mapSegments(const Header &header, const Range *segments, size_t count, FileRanges &ranges) {
+	ranges.count = 0;
+	for (size_t s = 0; s < count; s++) {
+		for (size_t i = 0; i < header.mappingCount && ranges.count < MaxRanges; i++) {
+			auto &mapping = header.mappings[i];
+			uint64_t start = segments[s].start > mapping.address ? segments[s].start : mapping.address;
+			uint64_t end = segments[s].end < mapping.address + mapping.size ? segments[s].end : mapping.address + mapping.size;
+			if (start < end) {
+				ranges.ranges[ranges.count].start = start - mapping.address + mapping.fileOffset;
+				ranges.ranges[ranges.count].end = end - mapping.address + mapping.fileOffset;
+				ranges.count++;
+			}
+		}
+	}
+}
+
+bool DyldSharedCache::subCacheSuffix(Reader reader, void *context, const Header &header, uint32_t index, char (&suffix)[MaxSuffix]) {
+	if (index >= header.subCacheCount)
+		return false;
+
+	if (!header.subCacheSuffixes) {
+		// Older caches name sub caches by their 1-based index.
+		char digits[12];
+		size_t length = 0;
+		uint32_t number = index + 1;
+		do {
+			digits[length++] = static_cast<char>('0' + number % 10);
+			number /= 10;
+		} while (number > 0);
+
+		suffix[0] = '.';
+		for (size_t i = 0; i < length; i++)
+			suffix[i + 1] = digits[length - 1 - i];
+		suffix[length + 1] = '\0';
+		return true;
+	}
+
+	uint64_t offset = header.subCacheOffset + static_cast<uint64_t>(index) * SubCacheEntryV2Size + SubCacheEntryV2Suffix;
+	if (!reader(context, offset, suffix, MaxSuffix))
+		return false;
+	suffix[MaxSuffix - 1] = '\0';
+	return true;
+}
@@ -0,0 +1,132 @@
+//
+//  DyldSharedCache.hpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef DyldSharedCache_h
+#define DyldSharedCache_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  Minimal dyld shared cache parser locating the file ranges of a cached image.
+ *  Depends on nothing but a read callback, so it also builds on the host against extracted cache files.
+ */
+class DyldSharedCache {
+public:
+	/**
+	 *  Read exactly size bytes at offset, returns false on failure
+	 */
+	using Reader = bool (*)(void *context, uint64_t offset, void *buffer, size_t size);
+
+	static constexpr size_t MaxMappings = 16;
+	static constexpr size_t MaxSegments = 8;
+	static constexpr size_t MaxRanges = MaxSegments * 2;
+	static constexpr size_t MaxSuffix = 32;
+	static constexpr size_t ImageInfoSize = 32;
+	static constexpr size_t ImageBatch = 128;
+	static constexpr size_t PathWindowSize = 8192;
+
+	/**
+	 *  Virtual memory range
+	 */
+	struct Range {
+		uint64_t start;
+		uint64_t end;
+	};
+
+	/**
+	 *  Cache file mapping of virtual memory to file offsets
+	 */
+	struct Mapping {
+		uint64_t address;
+		uint64_t size;
+		uint64_t fileOffset;
+	};
+
+	/**
+	 *  Parsed cache file header
+	 */
+	struct Header {
+		size_t mappingCount;
+		Mapping mappings[MaxMappings];
+		uint32_t imagesOffset;
+		uint32_t imagesCount;
+		uint32_t subCacheOffset;
+		uint32_t subCacheCount;
+		bool subCacheSuffixes;
+	};
+
+	/**
+	 *  File offset ranges of an image within one cache file
+	 */
+	struct FileRanges {
+		size_t count;
+		Range ranges[MaxRanges];
+
+		/**
+		 *  Check whether [offset, offset + size) overlaps any range
+		 */
+		bool intersects(uint64_t offset, uint64_t size) const {
+			for (size_t i = 0; i < count; i++)
+				if (offset < ranges[i].end && ranges[i].start < offset + size)
+					return true;
+			return false;
+		}
+	};
+
+	/**
+	 *  Image list scan buffers, too large for the kernel stack
+	 */
+	struct ImageScan {
+		uint8_t images[ImageBatch * ImageInfoSize];
+		char paths[PathWindowSize];
+	};
+
+	/**
+	 *  Parse the cache file header and mappings
+	 *
+	 *  @return true on success
+	 */
+	static bool parseHeader(Reader reader, void *context, Header &header);
+
+	/**
+	 *  Find image load address by its install path in a cache file with the image list (the main one).
+	 *  Image infos and paths are read in batches through the scan buffers.
+	 *
+	 *  @return true on success
+	 */
+	static bool findImage(Reader reader, void *context, const Header &header, const char *path, uint64_t &address, ImageScan &scan);
+
+	/**
+	 *  Translate a virtual address to a file offset in this cache file
+	 *
+	 *  @return true when the address is mapped by this file
+	 */
+	static bool fileOffset(const Header &header, uint64_t address, uint64_t &offset);
+
+	/**
+	 *  Read the segment ranges of an image, except __LINKEDIT shared by all images,
+	 *  from the cache file mapping its address
+	 *
+	 *  @return true on success
+	 */
+	static bool readSegments(Reader reader, void *context, const Header &header, uint64_t address, Range *segments, size_t &count);
+
+	/**
+	 *  Translate image segments to the file ranges of a cache file, which may be empty
+	 */
+	static void mapSegments(const Header &header, const Range *segments, size_t count, FileRanges &ranges);
+
+	/**
+	 *  Obtain the file name suffix of a sub cache, e.g. .1 or .01
+	 *
+	 *  @return true on success
+	 */
+	static bool subCacheSuffix(Reader reader, void *context, const Header &header, uint32_t index, char (&suffix)[MaxSuffix]);
+};
+
+#endif /* DyldSharedCache_h */
@@ -0,0 +1,199 @@
+//
+//  Matcher.cpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <Headers/kern_api.hpp>
+
+#include "Matcher.hpp"
+#include "SoftwareUpdate.hpp"
+
+constexpr Matcher::FindFunc Matcher::engines[EngineCount];
+const char *Matcher::engineNames[EngineCount] {
+	"memmem",
+	"anchored",
+	"horspool"
+};
+Matcher::Engine Matcher::engine {Memmem};
+uint64_t Matcher::engineNsPerPage;
+char Matcher::report[64] {"memmem uncalibrated"};
+
+/**
+ *  Rough byte frequency rank in executable pages, lower is rarer
+ */
+static uint32_t byteRank(uint8_t byte) {
+	if (byte == 0x00) return 4;
+	if (byte == 0xFF) return 3;
+	if (byte < 0x10 || byte == 0x20 || byte == 0x48 || byte == 0x89 || byte == 0x8B) return 2;
+	if (byte >= 'a' && byte <= 'z') return 1;
+	return 0;
+}
+
+void MatcherPattern::prepare(const void *find, size_t size) {
+	this->find = static_cast<const uint8_t *>(find);
+	this->size = size;
+
+	anchor = 0;
+	for (size_t i = 1; i < size; i++) {
+		if (byteRank(this->find[i]) < byteRank(this->find[anchor]))
+			anchor = i;
+	}
+
+	if (size > 0 && size <= UINT8_MAX) {
+		for (auto &s : shift)
+			s = static_cast<uint8_t>(size);
+		for (size_t i = 0; i + 1 < size; i++)
+			shift[this->find[i]] = static_cast<uint8_t>(size - 1 - i);
+	}
+}
+
+const void *Matcher::findMemmem(const void *data, size_t size, const MatcherPattern &pattern) {
+	return lilu_os_memmem(data, size, pattern.find, pattern.size);
+}
+
+const void *Matcher::findAnchored(const void *data, size_t size, const MatcherPattern &pattern) {
+	if (pattern.size == 0 || size < pattern.size)
+		return nullptr;
+
+	auto bytes = static_cast<const uint8_t *>(data);
+	auto anchorByte = pattern.find[pattern.anchor];
+	for (size_t i = pattern.anchor, last = size - pattern.size + pattern.anchor; i <= last; i++) {
+		if (bytes[i] == anchorByte && memcmp(&bytes[i - pattern.anchor], pattern.find, pattern.size) == 0)
+			return &bytes[i - pattern.anchor];
+	}
+
+	return nullptr;
+}
+
+const void *Matcher::findHorspool(const void *data, size_t size, const MatcherPattern &pattern) {
+	if (pattern.size == 0 || pattern.size > UINT8_MAX)
+		return findMemmem(data, size, pattern);
+	if (size < pattern.size)
+		return nullptr;
+
+	auto bytes = static_cast<const uint8_t *>(data);
+	auto lastByte = pattern.find[pattern.size - 1];
+	for (size_t i = 0; i <= size - pattern.size; ) {
+		auto tail = bytes[i + pattern.size - 1];
+		if (tail == lastByte && memcmp(&bytes[i], pattern.find, pattern.size - 1) == 0)
+			return &bytes[i];
+		i += pattern.shift[tail];
+	}
+
+	return nullptr;
+}
+
+void Matcher::calibrate(const MatcherPattern *const *patterns, size_t count) {
+	if (count == 0)
+		return;
+
+	auto page = Buffer::create<uint8_t>(PAGE_SIZE);
+	if (page == nullptr) {
+		SYSLOG("match", "failed to allocate calibration page");
+		return;
+	}
+
+	uint64_t start = mach_absolute_time();
+	uint64_t budget = 0;
+	nanoseconds_to_absolutetime(CalibrationBudgetNs, &budget);
+
+	// Code-like filler with plenty of zero bytes, which are the worst case for naive scanning.
+	uint32_t seed = 0x2545F491;
+	for (size_t i = 0; i < PAGE_SIZE; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		page[i] = (seed & 3) == 0 ? 0 : static_cast<uint8_t>(seed >> 8);
+	}
+
+	uint64_t best = UINT64_MAX;
+	Engine chosen = Memmem;
+	for (uint32_t e = 0; e < EngineCount; e++) {
+		uint64_t elapsed = 0;
+		bool correct = true;
+		size_t rounds = 0;
+		// Every measured scan covers one page, patterns that cannot be placed are not measured.
+		uint64_t scans = 0;
+		for (; rounds < CalibrationRounds && correct; rounds++) {
+			if (mach_absolute_time() - start > budget)
+				break;
+
+			// Place each pattern at the page end, so that the whole page is scanned, and check against memmem.
+			for (size_t p = 0; p < count && correct; p++) {
+				auto &pattern = *patterns[p];
+				uint8_t saved[256];
+				if (pattern.size == 0 || pattern.size > sizeof(saved))
+					continue;
+				auto target = &page[PAGE_SIZE - pattern.size];
+				memcpy(saved, target, pattern.size);
+				memcpy(target, pattern.find, pattern.size);
+
+				auto expected = findMemmem(page, PAGE_SIZE, pattern);
+				uint64_t before = mach_absolute_time();
+				auto found = engines[e](page, PAGE_SIZE, pattern);
+				elapsed += mach_absolute_time() - before;
+				scans++;
+				correct = found == expected;
+
+				memcpy(target, saved, pattern.size);
+			}
+		}
+
+		if (!correct) {
+			SYSLOG("match", "engine %s produced wrong results", engineNames[e]);
+			continue;
+		}
+
+		if (rounds < CalibrationRounds) {
+			DBGLOG("match", "calibration budget exhausted at engine %s", engineNames[e]);
+			break;
+		}
+
+		if (scans == 0) {
+			DBGLOG("match", "no pattern fits the calibration page");
+			break;
+		}
+
+		uint64_t perPage = elapsed / scans;
+		DBGLOG("match", "engine %s takes %llu abs per page over %llu scans", engineNames[e], perPage, scans);
+		if (perPage < best) {
+			best = perPage;
+			chosen = static_cast<Engine>(e);
+		}
+	}
+
+	Buffer::deleter(page);
+
+	// Without a single complete measurement the default engine stays and is reported as uncalibrated.
+	if (best != UINT64_MAX) {
+		engine = chosen;
+		absolutetime_to_nanoseconds(best, &engineNsPerPage);
+		snprintf(report, sizeof(report), "%s %llu ns/page", engineNames[engine], engineNsPerPage);
+	} else {
+		snprintf(report, sizeof(report), "%s uncalibrated", engineNames[engine]);
+	}
+
+	DBGLOG("match", "chosen %s", report);
+}
+
+static int matcherSysctlHandler(__unused struct sysctl_oid *oidp, void *arg1, __unused int arg2, struct sysctl_req *req) {
+	auto value = static_cast<const char *>(arg1);
+	return SYSCTL_OUT(req, value, strlen(value) + 1);
+}
+
+void Matcher::publish(KernelPatcher &patcher) {
+	static sysctl_oid matcherOid {
+		.oid_number = OID_AUTO,
+		.oid_kind = static_cast<int>(CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_LOCKED | CTLFLAG_OID2),
+		.oid_arg1 = report,
+		.oid_name = "revmatcher",
+		.oid_handler = matcherSysctlHandler,
+		.oid_fmt = "A",
+		.oid_descr = "RestrictEvents matcher engine",
+		.oid_version = SYSCTL_OID_VERSION
+	};
+
+	registerSysctl(patcher, "debug", &matcherOid);
+}
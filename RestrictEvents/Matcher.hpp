@@ -0,0 +1,106 @@
+//
+//  Matcher.hpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef Matcher_h
+#define Matcher_h
+
+#include <Headers/kern_api.hpp>
+
+/**
+ *  Find pattern with the data needed by every matcher engine
+ */
+struct MatcherPattern {
+	const uint8_t *find {nullptr};
+	size_t size {0};
+	// Offset of the rarest pattern byte for the anchored engine.
+	size_t anchor {0};
+	// Horspool bad character shifts, only valid for patterns up to UINT8_MAX bytes.
+	uint8_t shift[256] {};
+
+	/**
+	 *  Precompute engine data for the pattern, which must outlive this object
+	 *
+	 *  @param find  pattern
+	 *  @param size  pattern size
+	 */
+	void prepare(const void *find, size_t size);
+};
+
+/**
+ *  Pattern search with the engine chosen by boot-time calibration
+ */
+class Matcher {
+public:
+	/**
+	 *  Available engines
+	 */
+	enum Engine : uint32_t {
+		Memmem,
+		Anchored,
+		Horspool,
+		EngineCount
+	};
+
+	/**
+	 *  Find the first pattern occurrence
+	 *
+	 *  @param data     buffer to search
+	 *  @param size     buffer size
+	 *  @param pattern  prepared pattern
+	 *
+	 *  @return pattern start or nullptr
+	 */
+	static const void *find(const void *data, size_t size, const MatcherPattern &pattern) {
+		return engines[engine](data, size, pattern);
+	}
+
+	/**
+	 *  Measure all engines on synthetic pages with the given patterns and select the fastest correct one.
+	 *  Stays within CalibrationBudgetNs and keeps Memmem when nothing could be measured.
+	 *
+	 *  @param patterns  enabled patterns
+	 *  @param count     pattern count
+	 */
+	static void calibrate(const MatcherPattern *const *patterns, size_t count);
+
+	/**
+	 *  Report the chosen engine through debug.revmatcher sysctl
+	 *
+	 *  @param patcher  kernel patcher
+	 */
+	static void publish(KernelPatcher &patcher);
+
+private:
+	using FindFunc = const void *(*)(const void *data, size_t size, const MatcherPattern &pattern);
+
+	static const void *findMemmem(const void *data, size_t size, const MatcherPattern &pattern);
+	static const void *findAnchored(const void *data, size_t size, const MatcherPattern &pattern);
+	static const void *findHorspool(const void *data, size_t size, const MatcherPattern &pattern);
+
+	/**
+	 *  Total calibration time limit
+	 */
+	static constexpr uint64_t CalibrationBudgetNs = 500000;
+
+	/**
+	 *  Measured scans per engine
+	 */
+	static constexpr size_t CalibrationRounds = 8;
+
+	static constexpr FindFunc engines[EngineCount] {
+		findMemmem,
+		findAnchored,
+		findHorspool
+	};
+
+	static const char *engineNames[EngineCount];
+	static Engine engine;
+	static uint64_t engineNsPerPage;
+	static char report[64];
+};
+
+#endif /* Matcher_h */
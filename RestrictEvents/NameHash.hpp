@@ -0,0 +1,41 @@
+//
+//  NameHash.hpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef NameHash_h
+#define NameHash_h
+
+#include <Headers/kern_api.hpp>
+
+/**
+ *  32-bit FNV-1a hash of process names
+ */
+class NameHash {
+public:
+	static constexpr uint32_t Offset = 2166136261U;
+	static constexpr uint32_t Prime  = 16777619U;
+
+	/**
+	 *  Add one byte to a running hash, which starts at Offset
+	 */
+	static constexpr uint32_t append(uint32_t hash, char c) {
+		return (hash ^ static_cast<uint8_t>(c)) * Prime;
+	}
+
+	/**
+	 *  Hash the first len bytes of a name
+	 */
+	static constexpr uint32_t hash(const char *name, size_t len) {
+		uint32_t value = Offset;
+		for (size_t i = 0; i < len; i++)
+			value = append(value, name[i]);
+		return value;
+	}
+};
+
+static_assert(NameHash::hash("a", 1) == 0xE40C292CU, "Invalid FNV-1a hash");
+
+#endif /* NameHash_h */
@@ -0,0 +1,113 @@
+//
+//  Precompute.cpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <Headers/kern_api.hpp>
+
+#include "Precompute.hpp"
+
+Precompute::Slot Precompute::slots[MaxSlots];
+Precompute::Job Precompute::jobs[KindCount];
+Precompute::Release Precompute::releases[KindCount];
+thread_call_t Precompute::workerCall;
+
+bool Precompute::init() {
+	if (workerCall != nullptr)
+		return true;
+
+	// Jobs block on file I/O, which does not belong to the high priority group used by thread_call_allocate.
+	workerCall = thread_call_allocate_with_priority(worker, nullptr, THREAD_CALL_PRIORITY_KERNEL);
+	if (workerCall == nullptr) {
+		SYSLOG("pre", "failed to allocate precompute thread call");
+		return false;
+	}
+
+	return true;
+}
+
+void Precompute::registerJob(Kind kind, Job job, Release release) {
+	jobs[kind] = job;
+	releases[kind] = release;
+}
+
+bool Precompute::recycle(Slot &slot, uint32_t state) {
+	if (!__atomic_compare_exchange_n(&slot.state, &state, Claimed, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return false;
+
+	auto result = __atomic_load_n(&slot.result, __ATOMIC_RELAXED);
+	if (result != nullptr)
+		releases[slot.kind](result);
+	slot.result = nullptr;
+	__atomic_store_n(&slot.state, Free, __ATOMIC_RELEASE);
+	return true;
+}
+
+const void *Precompute::lookup(vnode_t vp, Kind kind) {
+	if (workerCall == nullptr || jobs[kind] == nullptr)
+		return nullptr;
+
+	auto vid = vnode_vid(vp);
+	Slot *freeSlot = nullptr;
+	for (auto &slot : slots) {
+		auto state = __atomic_load_n(&slot.state, __ATOMIC_ACQUIRE);
+		if (state == Free || state == Claimed) {
+			if (freeSlot == nullptr && state == Free)
+				freeSlot = &slot;
+			continue;
+		}
+
+		if (slot.vnode != vp || slot.kind != kind)
+			continue;
+
+		if (slot.vid == vid)
+			return state == Ready ? __atomic_load_n(&slot.result, __ATOMIC_ACQUIRE) : nullptr;
+
+		// The vnode was recycled, its pages are no longer validated with the old result.
+		if ((state == Ready || state == Failed) && recycle(slot, state) && freeSlot == nullptr)
+			freeSlot = &slot;
+	}
+
+	// Concurrent faults on the same vnode may claim two slots, which only wastes one job.
+	if (freeSlot != nullptr) {
+		uint32_t expected = Free;
+		if (__atomic_compare_exchange_n(&freeSlot->state, &expected, Claimed, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			freeSlot->kind = kind;
+			freeSlot->vnode = vp;
+			freeSlot->vid = vid;
+			__atomic_store_n(&freeSlot->state, Pending, __ATOMIC_RELEASE);
+			thread_call_enter(workerCall);
+		}
+	}
+
+	return nullptr;
+}
+
+void Precompute::worker(thread_call_param_t, thread_call_param_t) {
+	auto ctx = vfs_context_create(nullptr);
+	for (auto &slot : slots) {
+		// The thread call may run concurrently with itself, so each pending slot is claimed by one worker only.
+		uint32_t expected = Pending;
+		if (!__atomic_compare_exchange_n(&slot.state, &expected, Running, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			continue;
+
+		// The vnode may have been recycled since it was seen in the page hook, then nobody needs the slot.
+		if (vnode_getwithvid(slot.vnode, slot.vid) != 0) {
+			DBGLOG("pre", "vnode %p vid %u recycled before precomputation", slot.vnode, slot.vid);
+			__atomic_store_n(&slot.state, Free, __ATOMIC_RELEASE);
+			continue;
+		}
+
+		auto result = jobs[slot.kind](slot.vnode, ctx);
+		vnode_put(slot.vnode);
+
+		DBGLOG("pre", "precomputed kind %u for vnode %p vid %u - %d", slot.kind, slot.vnode, slot.vid, result != nullptr);
+		__atomic_store_n(&slot.result, result, __ATOMIC_RELEASE);
+		__atomic_store_n(&slot.state, result != nullptr ? Ready : Failed, __ATOMIC_RELEASE);
+	}
+
+	if (ctx != nullptr)
+		vfs_context_rele(ctx);
+}
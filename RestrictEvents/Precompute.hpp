@@ -0,0 +1,114 @@
+//
+//  Precompute.hpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef Precompute_h
+#define Precompute_h
+
+#include <Headers/kern_api.hpp>
+
+/**
+ *  Background precomputation of per-file data used by the page validation hooks.
+ *  Jobs run on a thread call, so that no expensive work happens on the page fault path.
+ */
+class Precompute {
+public:
+	/**
+	 *  Precomputation job kinds
+	 */
+	enum Kind : uint32_t {
+		SharedCache,
+		KindCount
+	};
+
+	/**
+	 *  Job function, called with an iocount held on the vnode.
+	 *  Returns the published result or nullptr on failure.
+	 */
+	using Job = const void *(*)(vnode_t vp, vfs_context_t ctx);
+
+	/**
+	 *  Result release function, called once the vnode of the result is recycled
+	 */
+	using Release = void (*)(const void *result);
+
+	/**
+	 *  Allocate the worker thread call
+	 *
+	 *  @return true on success
+	 */
+	static bool init();
+
+	/**
+	 *  Register a job function for a kind, must be done before the hooks are installed
+	 *
+	 *  @param kind     job kind
+	 *  @param job      job function
+	 *  @param release  result release function
+	 */
+	static void registerJob(Kind kind, Job job, Release release);
+
+	/**
+	 *  Obtain the precomputed result for a vnode, enqueuing its job on first sight
+	 *
+	 *  @param vp    vnode being validated
+	 *  @param kind  job kind
+	 *
+	 *  @return published result or nullptr while it is unavailable
+	 */
+	static const void *lookup(vnode_t vp, Kind kind);
+
+private:
+	/**
+	 *  Slot states
+	 */
+	enum State : uint32_t {
+		Free,
+		Claimed,
+		Pending,
+		Running,
+		Ready,
+		Failed
+	};
+
+	/**
+	 *  Tracked vnode, fields other than state are only written while the slot is Claimed or Running
+	 */
+	struct Slot {
+		uint32_t state;
+		Kind kind;
+		vnode_t vnode;
+		uint32_t vid;
+		const void *result;
+	};
+
+	/**
+	 *  Maximum tracked vnodes, matches the amount of shared cache files with some headroom
+	 */
+	static constexpr size_t MaxSlots = 32;
+
+	/**
+	 *  Release the result of a Ready or Failed slot and return it to Free
+	 *
+	 *  @param slot   slot to recycle
+	 *  @param state  slot state observed by the caller
+	 *
+	 *  @return false when another thread changed the slot first
+	 */
+	static bool recycle(Slot &slot, uint32_t state);
+
+	/**
+	 *  Worker thread call entry point
+	 */
+	static void worker(thread_call_param_t param0, thread_call_param_t param1);
+
+	static Slot slots[MaxSlots];
+	static Job jobs[KindCount];
+	static Release releases[KindCount];
+	static thread_call_t workerCall;
+};
+
+#endif /* Precompute_h */
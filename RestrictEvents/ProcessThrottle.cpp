@@ -0,0 +1,85 @@
+//
+//  ProcessThrottle.cpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <Headers/kern_api.hpp>
+
+#include "NameHash.hpp"
+#include "ProcessThrottle.hpp"
+
+//
+// Private definitions from osfmk/kern/policy_internal.h and sys/resource.h
+//
+static constexpr int TaskPolicyExternal = 0x1;
+static constexpr int TaskPolicyDarwinBg = 0x10;
+static constexpr int TaskPolicyIoPol    = 0x11;
+static constexpr int IoPolThrottle      = 3;
+
+/**
+ *  Darwin background implies the lowest CPU priority and throttled I/O, the I/O policy is set for clarity.
+ */
+static constexpr TaskPolicy backgroundPolicies[] {
+	{TaskPolicyExternal, TaskPolicyDarwinBg, 1},
+	{TaskPolicyExternal, TaskPolicyIoPol, IoPolThrottle},
+};
+
+/**
+ *  revthrottle option with the process it throttles
+ */
+struct ThrottleRule {
+	const char *option;
+	const char *process;
+	const TaskPolicy *policies;
+	size_t policyCount;
+};
+
+static constexpr ThrottleRule throttleRules[] {
+	{"media", "mediaanalysisd", backgroundPolicies, arrsize(backgroundPolicies)},
+	{"photo", "photoanalysisd", backgroundPolicies, arrsize(backgroundPolicies)},
+	{"mds",   "mds_stores",     backgroundPolicies, arrsize(backgroundPolicies)},
+};
+
+static_assert(arrsize(throttleRules) <= ProcessThrottle::MaxProcesses, "Too many throttle rules");
+
+const char *ProcessThrottle::processes[MaxProcesses];
+ProcessThrottle::PolicySet ProcessThrottle::processPolicies[MaxProcesses];
+uint64_t ProcessThrottle::processNames;
+
+uint64_t ProcessThrottle::nameBit(const char *name, size_t len) {
+	return 1ULL << (NameHash::hash(name, len) % 64);
+}
+
+void ProcessThrottle::configure(const char *value) {
+	size_t count = 0;
+	processNames = 0;
+	for (auto &rule : throttleRules) {
+		if (!strstr(value, rule.option, strlen(rule.option)))
+			continue;
+		processes[count] = rule.process;
+		processPolicies[count] = {rule.policies, rule.policyCount};
+		processNames |= nameBit(rule.process, strlen(rule.process));
+		DBGLOG("rev", "throttling %s", rule.process);
+		count++;
+	}
+
+	for (size_t i = count; i < MaxProcesses; i++) {
+		processes[i] = nullptr;
+		processPolicies[i] = {nullptr, 0};
+	}
+}
+
+ProcessThrottle::PolicySet ProcessThrottle::policiesFor(const char *name) {
+	// Most processes are rejected by the name bit without string comparisons.
+	if ((processNames & nameBit(name, strlen(name))) == 0)
+		return {nullptr, 0};
+
+	for (size_t i = 0; i < MaxProcesses && processes[i] != nullptr; i++) {
+		if (strcmp(name, processes[i]) == 0)
+			return processPolicies[i];
+	}
+
+	return {nullptr, 0};
+}
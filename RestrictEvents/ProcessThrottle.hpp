@@ -0,0 +1,75 @@
+//
+//  ProcessThrottle.hpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef ProcessThrottle_h
+#define ProcessThrottle_h
+
+#include <Headers/kern_api.hpp>
+
+/**
+ *  Task policy set by proc_set_task_policy
+ */
+struct TaskPolicy {
+	int category;
+	int flavor;
+	int value;
+};
+
+/**
+ *  Selection of processes moved to background on exec with revthrottle.
+ *  Contains no kernel calls, the caller applies the chosen task policies.
+ */
+class ProcessThrottle {
+public:
+	/**
+	 *  Task policies applied to a process
+	 */
+	struct PolicySet {
+		const TaskPolicy *policies;
+		size_t count;
+	};
+
+	/**
+	 *  Maximum throttled processes
+	 */
+	static constexpr size_t MaxProcesses = 4;
+
+	/**
+	 *  Select throttled processes from a revthrottle value, replacing the previous selection
+	 *
+	 *  @param value  comma separated options, e.g. media,mds
+	 */
+	static void configure(const char *value);
+
+	/**
+	 *  Check whether any process is throttled
+	 */
+	static bool enabled() {
+		return processNames != 0;
+	}
+
+	/**
+	 *  Obtain the task policies for a process
+	 *
+	 *  @param name  process name as reported by proc_name
+	 *
+	 *  @return policies to apply, empty when the process is not throttled
+	 */
+	static PolicySet policiesFor(const char *name);
+
+private:
+	/**
+	 *  Process name bit in processNames
+	 */
+	static uint64_t nameBit(const char *name, size_t len);
+
+	static const char *processes[MaxProcesses];
+	static PolicySet processPolicies[MaxProcesses];
+	static uint64_t processNames;
+};
+
+#endif /* ProcessThrottle_h */
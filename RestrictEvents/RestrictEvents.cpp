@@ -10,9 +10,17 @@
 #include <Headers/kern_devinfo.hpp>
 #include <Headers/kern_nvram.hpp>
 #include <Headers/kern_efi.hpp>
+#include <Headers/kern_file.hpp>
 #include <Headers/plugin_start.hpp>
 #include <Headers/kern_policy.hpp>
 
+#include "AppleSystemInfoPatches.hpp"
+#include "DyldSharedCache.hpp"
+#include "Matcher.hpp"
+#include "NameHash.hpp"
+#include "Precompute.hpp"
+#include "ProcessThrottle.hpp"
+#include "SparsePatch.hpp"
 #include "SoftwareUpdate.hpp"
 #include "vnode_types.hpp"
 
@@ -35,13 +43,98 @@ static const char *bootargBeta[] {
 
 static void *vnodePagerOpsKernel;
 
-static const char *binPathSystemInformation;
-static const char binPathSystemInformationLegacy[]   = "/Applications/Utilities/System Information.app/Contents/MacOS/System Information";
-static const char binPathSystemInformationCatalina[] = "/System/Applications/Utilities/System Information.app/Contents/MacOS/System Information";
-static const char binPathSPMemoryReporter[]          = "/System/Library/SystemProfiler/SPMemoryReporter.spreporter/Contents/MacOS/SPMemoryReporter";
-static const char binPathAboutExtension[]            = "/System/Library/ExtensionKit/Extensions/AboutExtension.appex/Contents/MacOS/AboutExtension";
+/**
+ *  Kinds of patches applied to the binaries in targetBinaries.
+ */
+enum class TargetPatch : uint8_t {
+	Model,
+	ModelMemory,
+	DiskArbitration
+};
+
+/**
+ *  Userspace binary to patch in performReplacements.
+ */
+struct TargetBinary {
+	const char *path;
+	size_t pathSize;
+	KernelVersion minKernel;
+	KernelVersion maxKernel;
+	TargetPatch patch;
+	const char *name;
+
+	template <size_t N>
+	constexpr TargetBinary(const char (&path)[N], KernelVersion minKernel, KernelVersion maxKernel, TargetPatch patch, const char *name) :
+		path(path), pathSize(N - 1), minKernel(minKernel), maxKernel(maxKernel), patch(patch), name(name) {}
+};
+
+/**
+ *  No upper kernel version limit for a target binary.
+ */
+static constexpr KernelVersion KernelVersionAny = static_cast<KernelVersion>(0);
+
+//
+// Mountain Lion only has the MacBookAir whitelist in System Information.
+// Mavericks has the MacBookAir/MacBookPro10 whitelist in System Information and SPMemoryReporter.
+// Yosemite and newer have the MacBookAir/MacBookPro10 whitelist in System Information, SPMemoryReporter, and AppleSystemInfo.framework.
+//
+static constexpr TargetBinary targetBinaries[] {
+	{"/System/Library/ExtensionKit/Extensions/AboutExtension.appex/Contents/MacOS/AboutExtension",
+		KernelVersion::Ventura, KernelVersionAny, TargetPatch::Model, "AboutExtension"},
+	{"/Applications/Utilities/System Information.app/Contents/MacOS/System Information",
+		KernelVersion::MountainLion, KernelVersion::Mojave, TargetPatch::Model, "System Information.app"},
+	{"/System/Applications/Utilities/System Information.app/Contents/MacOS/System Information",
+		KernelVersion::Catalina, KernelVersionAny, TargetPatch::Model, "System Information.app"},
+	{"/System/Library/SystemProfiler/SPMemoryReporter.spreporter/Contents/MacOS/SPMemoryReporter",
+		KernelVersion::Mavericks, KernelVersionAny, TargetPatch::ModelMemory, "SPMemoryReporter.spreporter"},
+	{"/System/Library/Frameworks/DiskArbitration.framework/Versions/A/Support/DiskArbitrationAgent",
+		KernelVersion::MountainLion, KernelVersionAny, TargetPatch::DiskArbitration, "DiskArbitrationAgent"},
+};
+
+/**
+ *  Perfect hash over targetBinaries, sampling the path length and two path bytes.
+ *  Update the sampled positions when a new entry fails the collision check below.
+ */
+static constexpr size_t TargetBinaryHashSize = 8;
+static constexpr size_t TargetBinaryHashTail = 8;
+static constexpr uint8_t TargetBinaryNone = 0xFF;
 
-static const char binPathDiskArbitrationAgent[]     = "/System/Library/Frameworks/DiskArbitration.framework/Versions/A/Support/DiskArbitrationAgent";
+static constexpr size_t targetBinaryHash(const char *path, size_t pathSize) {
+	return (pathSize + static_cast<uint8_t>(path[pathSize - TargetBinaryHashTail]) + static_cast<uint8_t>(path[pathSize / 2])) & (TargetBinaryHashSize - 1);
+}
+
+struct TargetBinaryIndex {
+	uint8_t slots[TargetBinaryHashSize];
+	size_t minPathSize;
+	bool perfect;
+};
+
+static constexpr TargetBinaryIndex buildTargetBinaryIndex() {
+	TargetBinaryIndex index {};
+	index.perfect = true;
+	index.minPathSize = targetBinaries[0].pathSize;
+	for (size_t i = 0; i < TargetBinaryHashSize; i++)
+		index.slots[i] = TargetBinaryNone;
+	for (size_t i = 0; i < arrsize(targetBinaries); i++) {
+		auto hash = targetBinaryHash(targetBinaries[i].path, targetBinaries[i].pathSize);
+		if (index.slots[hash] != TargetBinaryNone)
+			index.perfect = false;
+		index.slots[hash] = static_cast<uint8_t>(i);
+		if (targetBinaries[i].pathSize < index.minPathSize)
+			index.minPathSize = targetBinaries[i].pathSize;
+	}
+	return index;
+}
+
+static constexpr TargetBinaryIndex targetBinaryIndex = buildTargetBinaryIndex();
+static_assert(targetBinaryIndex.perfect, "Target binary hash has collisions, adjust targetBinaryHash");
+static_assert(targetBinaryIndex.minPathSize >= TargetBinaryHashTail, "Target binary path is too short for targetBinaryHash");
+static_assert(arrsize(targetBinaries) < TargetBinaryNone, "Too many target binaries");
+
+/**
+ *  Target binaries enabled for this boot, resolved once at plugin start.
+ */
+static bool targetBinaryEnabled[arrsize(targetBinaries)];
 
 static bool enableMemoryUiPatching;
 static bool enablePciUiPatching;
@@ -54,13 +147,20 @@ static bool enableF16cPatching;
 static bool verboseProcessLogging;
 static mach_vm_address_t orgCsValidateFunc;
 
-static const void *modelFindPatch;
-static const void *modelReplPatch;
-static size_t modelFindSize;
+// On 13.0 MacPro7,1 string literal is inlined, but "MacPro7," will do the matching, thus exclude '\0'.
+static constexpr auto modelPatchMacPro71 = makeSparsePatch<sizeof("MacPro7,") - 1, sizeof("HacPro7,") - 1>("MacPro7,", "HacPro7,");
+static_assert(sparsePatchEquivalent(modelPatchMacPro71, "MacPro7,", "HacPro7,", sizeof("HacPro7,") - 1), "Invalid MacPro7,1 model patch");
+static constexpr auto modelPatchMacBookAir = makeSparsePatch("MacBookAir", "HacBookAir");
+static_assert(sparsePatchEquivalent(modelPatchMacBookAir, "MacBookAir", "HacBookAir"), "Invalid MacBookAir model patch");
+static constexpr auto modelPatchMacBookPro10 = makeSparsePatch("MacBookPro10", "HacBookPro10");
+static_assert(sparsePatchEquivalent(modelPatchMacBookPro10, "MacBookPro10", "HacBookPro10"), "Invalid MacBookPro10 model patch");
+
+static const char *modelName;
+static SparsePatchRef modelPatch {nullptr, 0, nullptr, 0};
 
 static bool needsMemPatch;
-static const char memFindPatch[] = "MacBookAir\0MacBookPro10";
-static const char memReplPatch[] = "HacBookAir\0HacBookPro10";
+static constexpr auto memPatch = makeSparsePatch(memFindPatch, memReplPatch);
+static_assert(sparsePatchEquivalent(memPatch, memFindPatch, memReplPatch), "Invalid model whitelist patch");
 
 static constexpr size_t CpuSignatureWords = 12;
 static const char *cpuFindPatch;
@@ -69,22 +169,88 @@ static uint8_t cpuReplPatch[CpuSignatureWords * sizeof(uint32_t) + 1];
 static size_t cpuReplSize;
 
 static bool needsCpuNamePatch;
+
+static MatcherPattern modelPattern;
+static MatcherPattern memPattern;
+static MatcherPattern cpuPattern;
+static MatcherPattern unlockCoreCountPattern;
+static MatcherPattern diskArbitrationPattern;
 static bool needsUnlockCoreCount;
-static uint8_t findUnlockCoreCount[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
-static uint8_t replUnlockCoreCount[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x1C };
+// Core count byte, set to the actual core count once it is known.
+static PatchEdit editUnlockCoreCount { 16, 0x1C };
+static const SparsePatchRef unlockCoreCountPatch { findUnlockCoreCount, sizeof(findUnlockCoreCount), &editUnlockCoreCount, 1 };
 static pmCallBacks_t pmCallbacks;
 
-static uint8_t findDiskArbitrationPatch[] = { 0x83, 0xF8, 0x02 };
-static uint8_t replDiskArbitrationPatch[] = { 0x83, 0xF8, 0x0F };
+static constexpr uint8_t findDiskArbitrationPatch[] = { 0x83, 0xF8, 0x02 };
+static constexpr uint8_t replDiskArbitrationPatch[] = { 0x83, 0xF8, 0x0F };
+static constexpr auto diskArbitrationPatch = makeSparsePatch(findDiskArbitrationPatch, replDiskArbitrationPatch);
+static_assert(sparsePatchEquivalent(diskArbitrationPatch, findDiskArbitrationPatch, replDiskArbitrationPatch), "Invalid DiskArbitration patch");
 
 const char *procBlacklist[10] = {};
 
+/**
+ *  Bit set of procBlacklist basename hashes, checked before resolving full paths
+ */
+static uint64_t procBlacklistNames;
+
+static task_t (*procTask)(proc_t proc);
+static void (*procSetTaskPolicy)(task_t task, int category, int flavor, int value);
+
 struct RestrictEventsPolicy {
 
+	/**
+	 *  Basename bit in procBlacklistNames
+	 */
+	static uint64_t procNameBit(const char *name, size_t len) {
+		return 1ULL << (NameHash::hash(name, len) % 64);
+	}
+
+	/**
+	 *  Returns false when the executable certainly is not in procBlacklist
+	 */
+	static bool mayBeBlacklisted(vnode_t vp) {
+		if (procBlacklistNames == 0)
+			return false;
+
+		// Use the vnode name rather than componentname, which holds the symlink name when executed through one.
+		auto name = vnode_getname(vp);
+		if (name == nullptr)
+			return true;
+
+		bool found = (procBlacklistNames & procNameBit(name, strlen(name))) != 0;
+		vnode_putname(name);
+		return found;
+	}
+
+	/**
+	 *  Policy to move throttled processes to background once they are executed.
+	 *  The exec check runs in the parent context for posix_spawn, so the policy cannot be applied there.
+	 *  Only registered when some process is throttled.
+	 */
+	static void policyNotifyExecComplete(proc_t p) {
+		if (procTask == nullptr || procSetTaskPolicy == nullptr)
+			return;
+
+		char name[64];
+		proc_name(proc_pid(p), name, sizeof(name));
+		auto set = ProcessThrottle::policiesFor(name);
+		if (set.count == 0)
+			return;
+
+		auto task = procTask(p);
+		for (size_t i = 0; i < set.count; i++)
+			procSetTaskPolicy(task, set.policies[i].category, set.policies[i].flavor, set.policies[i].value);
+		DBGLOG("rev", "throttling process %s", name);
+	}
+
 	/**
 	 *  Policy to restrict blacklisted process execution
 	 */
 	static int policyCheckExecve(kauth_cred_t cred, struct vnode *vp, struct vnode *scriptvp, struct label *vnodelabel, struct label *scriptlabel, struct label *execlabel, struct componentname *cnp, u_int *csflags, void *macpolicyattr, size_t macpolicyattrlen) {
+		// Most executables are rejected by their name without building the full path.
+		if (!verboseProcessLogging && !mayBeBlacklisted(vp))
+			return 0;
+
 		char pathbuf[MAXPATHLEN];
 		int len = MAXPATHLEN;
 		int err = vn_getpath(vp, pathbuf, &len);
@@ -105,55 +271,272 @@ struct RestrictEventsPolicy {
 		return 0;
 	}
 
+	/**
+	 *  Find the enabled target binary matching the path, nullptr otherwise
+	 */
+	static const TargetBinary *findTargetBinary(const char *path, size_t pathSize) {
+		if (pathSize < targetBinaryIndex.minPathSize)
+			return nullptr;
+		auto slot = targetBinaryIndex.slots[targetBinaryHash(path, pathSize)];
+		if (LIKELY(slot == TargetBinaryNone) || !targetBinaryEnabled[slot])
+			return nullptr;
+		auto &binary = targetBinaries[slot];
+		if (binary.pathSize != pathSize || memcmp(path, binary.path, pathSize) != 0)
+			return nullptr;
+		return &binary;
+	}
+
+	/**
+	 *  Resolve which target binaries are to be patched on this boot
+	 */
+	static void enableTargetBinaries() {
+		auto kernel = getKernelVersion();
+		for (size_t i = 0; i < arrsize(targetBinaries); i++) {
+			auto &binary = targetBinaries[i];
+			if (kernel < binary.minKernel || (binary.maxKernel != KernelVersionAny && kernel > binary.maxKernel))
+				continue;
+			switch (binary.patch) {
+				case TargetPatch::Model:
+					targetBinaryEnabled[i] = modelName != nullptr;
+					break;
+				case TargetPatch::ModelMemory:
+					targetBinaryEnabled[i] = needsMemPatch && modelName != nullptr;
+					break;
+				case TargetPatch::DiskArbitration:
+					targetBinaryEnabled[i] = enableDiskArbitrationPatching;
+					break;
+			}
+			DBGLOG_COND(targetBinaryEnabled[i], "rev", "enabled patching %s", binary.path);
+		}
+	}
+
+	/**
+	 *  Shared cache file being parsed
+	 */
+	struct SharedCacheFile {
+		vnode_t vnode;
+		vfs_context_t ctx;
+	};
+
+	/**
+	 *  Shared cache job state, kept off the thread call stack
+	 */
+	struct SharedCacheJob {
+		char path[PATH_MAX];
+		char subPath[PATH_MAX];
+		DyldSharedCache::Header header;
+		DyldSharedCache::Header mainHeader;
+		DyldSharedCache::Header subHeader;
+		DyldSharedCache::Range segments[DyldSharedCache::MaxSegments];
+		DyldSharedCache::ImageScan scan;
+	};
+
+	/**
+	 *  AppleSystemInfo segments found through a main shared cache, reused for all of its sub cache files
+	 */
+	struct SharedCacheImage {
+		uint32_t state;
+		vnode_t vnode;
+		uint32_t vid;
+		size_t count;
+		DyldSharedCache::Range segments[DyldSharedCache::MaxSegments];
+	};
+
+	enum SharedCacheImageState : uint32_t {
+		SharedCacheImageFree,
+		SharedCacheImageClaimed,
+		SharedCacheImageReady
+	};
+
+	static constexpr size_t MaxSharedCacheImages = 4;
+
+	/**
+	 *  Main shared caches with known AppleSystemInfo segments, one per architecture is expected
+	 */
+	static SharedCacheImage *sharedCacheImages() {
+		static SharedCacheImage images[MaxSharedCacheImages];
+		return images;
+	}
+
+	/**
+	 *  Obtain AppleSystemInfo segments already found through this main shared cache
+	 */
+	static bool findSharedCacheImage(vnode_t mainVnode, DyldSharedCache::Range *segments, size_t &count) {
+		auto vid = vnode_vid(mainVnode);
+		auto images = sharedCacheImages();
+		for (size_t i = 0; i < MaxSharedCacheImages; i++) {
+			auto &image = images[i];
+			if (__atomic_load_n(&image.state, __ATOMIC_ACQUIRE) == SharedCacheImageReady && image.vnode == mainVnode && image.vid == vid) {
+				count = image.count;
+				memcpy(segments, image.segments, count * sizeof(segments[0]));
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 *  Remember AppleSystemInfo segments for the remaining files of this main shared cache.
+	 *  Concurrent jobs of the same cache may store it twice, which only wastes a slot.
+	 */
+	static void storeSharedCacheImage(vnode_t mainVnode, const DyldSharedCache::Range *segments, size_t count) {
+		auto images = sharedCacheImages();
+		for (size_t i = 0; i < MaxSharedCacheImages; i++) {
+			auto &image = images[i];
+			uint32_t expected = SharedCacheImageFree;
+			if (__atomic_compare_exchange_n(&image.state, &expected, SharedCacheImageClaimed, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				image.vnode = mainVnode;
+				image.vid = vnode_vid(mainVnode);
+				image.count = count;
+				memcpy(image.segments, segments, count * sizeof(segments[0]));
+				__atomic_store_n(&image.state, SharedCacheImageReady, __ATOMIC_RELEASE);
+				return;
+			}
+		}
+	}
+
+	static bool readSharedCache(void *context, uint64_t offset, void *buffer, size_t size) {
+		auto file = static_cast<SharedCacheFile *>(context);
+		return FileIO::readFileData(buffer, static_cast<off_t>(offset), size, file->vnode, file->ctx) == 0;
+	}
+
+	/**
+	 *  Read AppleSystemInfo segments from the sub cache mapping its address
+	 */
+	static bool readSubCacheSegments(SharedCacheJob &job, SharedCacheFile &mainFile, uint64_t address, size_t &count) {
+		for (uint32_t i = 0; i < job.mainHeader.subCacheCount; i++) {
+			char suffix[DyldSharedCache::MaxSuffix];
+			if (!DyldSharedCache::subCacheSuffix(readSharedCache, &mainFile, job.mainHeader, i, suffix))
+				return false;
+			snprintf(job.subPath, sizeof(job.subPath), "%s%s", job.path, suffix);
+
+			SharedCacheFile subFile {nullptr, mainFile.ctx};
+			if (vnode_lookup(job.subPath, 0, &subFile.vnode, subFile.ctx) != 0)
+				continue;
+			bool found = DyldSharedCache::parseHeader(readSharedCache, &subFile, job.subHeader) &&
+				DyldSharedCache::readSegments(readSharedCache, &subFile, job.subHeader, address, job.segments, count);
+			vnode_put(subFile.vnode);
+			if (found)
+				return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 *  Locate AppleSystemInfo segments through the main shared cache image list and remember them
+	 */
+	static bool readSharedCacheImage(SharedCacheJob &job, SharedCacheFile &file, SharedCacheFile &mainFile, size_t &count) {
+		uint64_t address = 0;
+		if (!DyldSharedCache::parseHeader(readSharedCache, &mainFile, job.mainHeader) ||
+			!DyldSharedCache::findImage(readSharedCache, &mainFile, job.mainHeader, binPathAppleSystemInfo, address, job.scan))
+			return false;
+
+		if (!DyldSharedCache::readSegments(readSharedCache, &file, job.header, address, job.segments, count) &&
+			!DyldSharedCache::readSegments(readSharedCache, &mainFile, job.mainHeader, address, job.segments, count) &&
+			!readSubCacheSegments(job, mainFile, address, count))
+			return false;
+
+		storeSharedCacheImage(mainFile.vnode, job.segments, count);
+		return true;
+	}
+
+	/**
+	 *  Precompute the file ranges of AppleSystemInfo in a shared cache file, runs on the Precompute worker
+	 */
+	static const void *sharedCacheJob(vnode_t vp, vfs_context_t ctx) {
+		auto job = Buffer::create<SharedCacheJob>(1);
+		if (job == nullptr)
+			return nullptr;
+
+		const DyldSharedCache::FileRanges *result = nullptr;
+		SharedCacheFile file {vp, ctx};
+		SharedCacheFile mainFile {nullptr, ctx};
+		int pathlen = sizeof(job->path);
+		if (vn_getpath(vp, job->path, &pathlen) == 0 && DyldSharedCache::parseHeader(readSharedCache, &file, job->header)) {
+			// Sub caches have no image list, it is in the main cache named without the suffix.
+			char *name = job->path;
+			for (auto p = job->path; *p != '\0'; p++)
+				if (*p == '/') name = p + 1;
+			for (auto p = name; *p != '\0'; p++) {
+				if (*p == '.') {
+					*p = '\0';
+					break;
+				}
+			}
+
+			bool mainFound = vnode_lookup(job->path, 0, &mainFile.vnode, ctx) == 0;
+			size_t count = 0;
+			if (mainFound && (findSharedCacheImage(mainFile.vnode, job->segments, count) ||
+				readSharedCacheImage(*job, file, mainFile, count))) {
+				auto ranges = Buffer::create<DyldSharedCache::FileRanges>(1);
+				if (ranges != nullptr) {
+					DyldSharedCache::mapSegments(job->header, job->segments, count, *ranges);
+					DBGLOG("rev", "found %lu AppleSystemInfo ranges in shared cache file %s", ranges->count, name);
+					result = ranges;
+				}
+			}
+
+			if (mainFound)
+				vnode_put(mainFile.vnode);
+		}
+
+		Buffer::deleter(job);
+		return result;
+	}
+
+	/**
+	 *  Free shared cache file ranges of a recycled vnode
+	 */
+	static void sharedCacheRelease(const void *result) {
+		Buffer::deleter(const_cast<DyldSharedCache::FileRanges *>(static_cast<const DyldSharedCache::FileRanges *>(result)));
+	}
+
 	/**
 	 *  Common userspace replacement code
 	 */
-	static void performReplacements(vnode_t vp, const void *data, vm_size_t size) {
+	static void performReplacements(vnode_t vp, memory_object_offset_t offset, const void *data, vm_size_t size) {
 		char path[PATH_MAX];
 		int pathlen = PATH_MAX;
-		if (vn_getpath(vp, path, &pathlen) == 0) {
+		if (vn_getpath(vp, path, &pathlen) == 0 && pathlen > 0) {
 			//DBGLOG("rev", "csValidatePage %s", path);
 
-			//
-			// Mountain Lion only has the MacBookAir whitelist in System Information.
-			// Mavericks has the MacBookAir/MacBookPro10 whitelist in System Information and SPMemoryReporter.
-			// Yosemite and newer have the MacBookAir/MacBookPro10 whitelist in System Information, SPMemoryReporter, and AppleSystemInfo.framework.
-			//
-			if (modelFindPatch != nullptr && getKernelVersion() >= KernelVersion::Ventura && UNLIKELY(strcmp(path, binPathAboutExtension) == 0)) {
-				if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), size, modelFindPatch, modelFindSize, modelReplPatch, modelFindSize))) {
-					DBGLOG("rev", "patched %s in AboutExtension", reinterpret_cast<const char *>(modelFindPatch));
-					return;
+			// pathlen includes the terminating '\0'.
+			auto binary = findTargetBinary(path, static_cast<size_t>(pathlen) - 1);
+			if (UNLIKELY(binary != nullptr)) {
+				switch (binary->patch) {
+					case TargetPatch::Model:
+					case TargetPatch::ModelMemory:
+						if (UNLIKELY(applySparsePatch(const_cast<void *>(data), size, modelPatch, modelPattern)))
+							DBGLOG("rev", "patched %s in %s", modelName, binary->name);
+						break;
+					case TargetPatch::DiskArbitration:
+						if (UNLIKELY(applySparsePatch(const_cast<void *>(data), size, diskArbitrationPatch, diskArbitrationPattern)))
+							DBGLOG("rev", "patched unreadable disk case in %s", binary->name);
+						break;
 				}
-			} else if (modelFindPatch != nullptr && UNLIKELY(strcmp(path, binPathSystemInformation) == 0)) {
-				if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), size, modelFindPatch, modelFindSize, modelReplPatch, modelFindSize))) {
-					DBGLOG("rev", "patched %s in System Information.app", reinterpret_cast<const char *>(modelFindPatch));
+			} else if ((needsMemPatch || cpuReplSize > 0) && UserPatcher::matchSharedCachePath(path)) {
+				// Once the shared cache file is parsed, only AppleSystemInfo pages are scanned.
+				auto ranges = static_cast<const DyldSharedCache::FileRanges *>(Precompute::lookup(vp, Precompute::SharedCache));
+				if (ranges != nullptr && !ranges->intersects(offset, size))
 					return;
-				}
-			} else if (needsMemPatch && modelFindPatch != nullptr && getKernelVersion() >= KernelVersion::Mavericks && UNLIKELY(strcmp(path, binPathSPMemoryReporter) == 0)) {
-				 if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), size, modelFindPatch, modelFindSize, modelReplPatch, modelFindSize))) {
-					 DBGLOG("rev", "patched %s in SPMemoryReporter.spreporter", reinterpret_cast<const char *>(modelFindPatch));
-					 return;
-				 }
-			} else if (enableDiskArbitrationPatching && UNLIKELY(strcmp(path, binPathDiskArbitrationAgent) == 0)) {
-				if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), size,
-																									 findDiskArbitrationPatch, sizeof(findDiskArbitrationPatch),
-																									 replDiskArbitrationPatch, sizeof(findDiskArbitrationPatch)))) {
-					DBGLOG("rev", "patched unreadable disk case in DiskArbitrationAgent");
-					return;
-				}
-			} else if (UserPatcher::matchSharedCachePath(path)) {
+
 				// Model check and CPU name may exist in the same page in AppleSystemInfo.
 				if (needsMemPatch && getKernelVersion() >= KernelVersion::Yosemite) {
-					if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), size, memFindPatch, sizeof(memFindPatch), memReplPatch, sizeof(memFindPatch)))) {
+					if (UNLIKELY(applySparsePatch(const_cast<void *>(data), size, memPatch, memPattern))) {
 						DBGLOG("rev", "patched model whitelist in AppleSystemInfo");
 					}
 				}
 
 				if (cpuReplSize > 0) {
-					if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), size, cpuFindPatch, cpuFindSize, cpuReplPatch, cpuReplSize))) {
-						DBGLOG("rev", "patched %s in AppleSystemInfo", reinterpret_cast<const char *>(cpuFindPatch + 1));
+					auto cpuName = const_cast<void *>(Matcher::find(data, size, cpuPattern));
+					// The replacement may be longer than the pattern and must fit in the buffer.
+					if (UNLIKELY(cpuName != nullptr) && static_cast<uint8_t *>(cpuName) + cpuReplSize <= static_cast<const uint8_t *>(data) + size) {
+						if (writeValidatedPage("cpu name", [&]() { memcpy(cpuName, cpuReplPatch, cpuReplSize); }))
+							DBGLOG("rev", "patched %s in AppleSystemInfo", reinterpret_cast<const char *>(cpuFindPatch + 1));
 						return;
-					} else if (needsUnlockCoreCount && UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), size, findUnlockCoreCount, sizeof(findUnlockCoreCount), replUnlockCoreCount, sizeof(replUnlockCoreCount)))) {
+					} else if (needsUnlockCoreCount && UNLIKELY(applySparsePatch(const_cast<void *>(data), size, unlockCoreCountPatch, unlockCoreCountPattern))) {
 						DBGLOG("rev", "patched core count in AppleSystemInfo");
 						return;
 					}
@@ -167,7 +550,7 @@ struct RestrictEventsPolicy {
 	 */
 	static void csValidatePageBigSur(vnode_t vp, memory_object_t pager, memory_object_offset_t page_offset, const void *data, int *validated_p, int *tainted_p, int *nx_p) {
 		FunctionCast(csValidatePageBigSur, orgCsValidateFunc)(vp, pager, page_offset, data, validated_p, tainted_p, nx_p);
-		performReplacements(vp, data, PAGE_SIZE);
+		performReplacements(vp, page_offset, data, PAGE_SIZE);
 	}
 
 	/**
@@ -175,7 +558,7 @@ struct RestrictEventsPolicy {
 	 */
 	static void csValidateRangeSierra(vnode_t vp, memory_object_t pager, memory_object_offset_t offset, const void *data, vm_size_t size, unsigned *result) {
 		FunctionCast(csValidateRangeSierra, orgCsValidateFunc)(vp, pager, offset, data, size, result);
-		performReplacements(vp, data, size);
+		performReplacements(vp, offset, data, size);
 	}
 
 	/**
@@ -184,7 +567,7 @@ struct RestrictEventsPolicy {
 	static bool csValidatePageMountainLion(void *blobs, memory_object_kernel_t pager, memory_object_offset_t page_offset, const void *data, int *tainted) {
 		bool result = FunctionCast(csValidatePageMountainLion, orgCsValidateFunc)(blobs, pager, page_offset, data, tainted);
 		if (pager != nullptr && pager->mo_pager_ops == vnodePagerOpsKernel)
-			performReplacements(reinterpret_cast<vnode_pager_t>(pager)->vnode_handle, data, PAGE_SIZE);
+			performReplacements(reinterpret_cast<vnode_pager_t>(pager)->vnode_handle, page_offset, data, PAGE_SIZE);
 		return result;
 	}
 
@@ -303,10 +686,47 @@ struct RestrictEventsPolicy {
 
 		for (auto &proc : procBlacklist) {
 			if (proc == nullptr) break;
+			auto name = proc;
+			for (auto p = proc; *p != '\0'; p++)
+				if (*p == '/') name = p + 1;
+			procBlacklistNames |= procNameBit(name, strlen(name));
 			DBGLOG("rev", "blocking %s", proc);
 		}
 	}
 
+	static void getThrottledProcesses() {
+		// Selects processes to throttle
+		char duip[128] { "none" };
+		if (PE_parse_boot_argn("revthrottle", duip, sizeof(duip))) {
+			DBGLOG("rev", "read revthrottle from boot-args");
+		} else if (readNvramVariable(NVRAM_PREFIX(LILU_VENDOR_GUID, "revthrottle"), u"revthrottle", &EfiRuntimeServices::LiluVendorGuid, duip, sizeof(duip))) {
+			DBGLOG("rev", "read revthrottle from NVRAM");
+		}
+
+		char *value = reinterpret_cast<char *>(&duip[0]);
+		value[sizeof(duip) - 1] = '\0';
+
+		// Exec completion notifications are only available in Catalina and newer
+		if (getKernelVersion() < KernelVersion::Catalina)
+			return;
+
+		ProcessThrottle::configure(value);
+	}
+
+	/**
+	 *  Resolve private task policy functions used for throttling
+	 */
+	static void solveThrottleSymbols(KernelPatcher &patcher) {
+		procTask = reinterpret_cast<decltype(procTask)>(patcher.solveSymbol(KernelPatcher::KernelID, "_proc_task"));
+		procSetTaskPolicy = reinterpret_cast<decltype(procSetTaskPolicy)>(patcher.solveSymbol(KernelPatcher::KernelID, "_proc_set_task_policy"));
+		if (procTask == nullptr || procSetTaskPolicy == nullptr) {
+			SYSLOG("rev", "failed to solve task policy functions, throttling is disabled");
+			procTask = nullptr;
+			procSetTaskPolicy = nullptr;
+			patcher.clearError();
+		}
+	}
+
 	static uint32_t getCoreCount() {
 		// I think AMD patches bork the topology structure, go over all the packages assuming single CPU systems.
 		// REF: https://github.com/acidanthera/bugtracker/issues/1625#issuecomment-831602457
@@ -392,57 +812,57 @@ struct RestrictEventsPolicy {
 
 		switch (cc) {
 			case 1:
-				cpuFindPatch = "\0" "Intel Core i5";
-				cpuFindSize = sizeof("\0" "Intel Core i5");
+				cpuFindPatch = cpuNameCoreI5;
+				cpuFindSize = sizeof(cpuNameCoreI5);
 				break;
 			case 2:
-				cpuFindPatch = getKernelVersion() >= KernelVersion::Catalina ? "\0" "Dual-Core Intel Core i5" : "\0" "Intel Core i5";
-				cpuFindSize = getKernelVersion() >= KernelVersion::Catalina ? sizeof("\0" "Dual-Core Intel Core i5") : sizeof("\0" "Intel Core i5");
+				cpuFindPatch = getKernelVersion() >= KernelVersion::Catalina ? cpuNameDualCoreI5 : cpuNameCoreI5;
+				cpuFindSize = getKernelVersion() >= KernelVersion::Catalina ? sizeof(cpuNameDualCoreI5) : sizeof(cpuNameCoreI5);
 				break;
 			case 4:
-				cpuFindPatch = getKernelVersion() >= KernelVersion::Catalina ? "\0" "Quad-Core Intel Core i5" : "\0" "Intel Core i5";
-				cpuFindSize = getKernelVersion() >= KernelVersion::Catalina ? sizeof("\0" "Quad-Core Intel Core i5") : sizeof("\0" "Intel Core i5");
+				cpuFindPatch = getKernelVersion() >= KernelVersion::Catalina ? cpuNameQuadCoreI5 : cpuNameCoreI5;
+				cpuFindSize = getKernelVersion() >= KernelVersion::Catalina ? sizeof(cpuNameQuadCoreI5) : sizeof(cpuNameCoreI5);
 				break;
 			case 6:
-				cpuFindPatch = getKernelVersion() >= KernelVersion::Catalina ? "\0" "6-Core Intel Core i5" : "\0" "Intel Core i5";
-				cpuFindSize = getKernelVersion() >= KernelVersion::Catalina ? sizeof("\0" "6-Core Intel Core i5") : sizeof("\0" "Intel Core i5");
+				cpuFindPatch = getKernelVersion() >= KernelVersion::Catalina ? cpuName6CoreI5 : cpuNameCoreI5;
+				cpuFindSize = getKernelVersion() >= KernelVersion::Catalina ? sizeof(cpuName6CoreI5) : sizeof(cpuNameCoreI5);
 				break;
 			case 8:
-				cpuFindPatch = "\0" "8-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "8-Core Intel Xeon W");
+				cpuFindPatch = cpuName8CoreXeonW;
+				cpuFindSize = sizeof(cpuName8CoreXeonW);
 				break;
 			case 10:
-				cpuFindPatch = "\0" "10-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "10-Core Intel Xeon W");
+				cpuFindPatch = cpuName10CoreXeonW;
+				cpuFindSize = sizeof(cpuName10CoreXeonW);
 				break;
 			case 12:
-				cpuFindPatch = "\0" "12-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "12-Core Intel Xeon W");
+				cpuFindPatch = cpuName12CoreXeonW;
+				cpuFindSize = sizeof(cpuName12CoreXeonW);
 				break;
 			case 14:
-				cpuFindPatch = "\0" "14-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "14-Core Intel Xeon W");
+				cpuFindPatch = cpuName14CoreXeonW;
+				cpuFindSize = sizeof(cpuName14CoreXeonW);
 				break;
 			case 16:
-				cpuFindPatch = "\0" "16-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "16-Core Intel Xeon W");
+				cpuFindPatch = cpuName16CoreXeonW;
+				cpuFindSize = sizeof(cpuName16CoreXeonW);
 				break;
 			case 18:
-				cpuFindPatch = "\0" "18-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "18-Core Intel Xeon W");
+				cpuFindPatch = cpuName18CoreXeonW;
+				cpuFindSize = sizeof(cpuName18CoreXeonW);
 				break;
 			case 24:
-				cpuFindPatch = "\0" "24-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "24-Core Intel Xeon W");
+				cpuFindPatch = cpuName24CoreXeonW;
+				cpuFindSize = sizeof(cpuName24CoreXeonW);
 				break;
 			case 28:
-				cpuFindPatch = "\0" "28-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "28-Core Intel Xeon W");
+				cpuFindPatch = cpuName28CoreXeonW;
+				cpuFindSize = sizeof(cpuName28CoreXeonW);
 				break;
 			default:
-				cpuFindPatch = "\0" "28-Core Intel Xeon W";
-				cpuFindSize = sizeof("\0" "28-Core Intel Xeon W");
-				replUnlockCoreCount[16] = cc;
+				cpuFindPatch = cpuName28CoreXeonW;
+				cpuFindSize = sizeof(cpuName28CoreXeonW);
+				editUnlockCoreCount.value = cc;
 				needsUnlockCoreCount = true;
 				break;
 		}
@@ -450,6 +870,38 @@ struct RestrictEventsPolicy {
 		DBGLOG("rev", "chosen %s patch for %u core CPU", cpuFindPatch + 1, cc);
 	}
 
+	/**
+	 *  Prepare the enabled patch patterns and select the fastest matcher engine for them
+	 */
+	static void prepareMatcher(KernelPatcher &patcher) {
+		const MatcherPattern *patterns[5] {};
+		size_t count = 0;
+
+		if (modelName != nullptr) {
+			modelPattern.prepare(modelPatch.find, modelPatch.findSize);
+			patterns[count++] = &modelPattern;
+		}
+		if (needsMemPatch) {
+			memPattern.prepare(memPatch.find, sizeof(memPatch.find));
+			patterns[count++] = &memPattern;
+		}
+		if (cpuReplSize > 0) {
+			cpuPattern.prepare(cpuFindPatch, cpuFindSize);
+			patterns[count++] = &cpuPattern;
+		}
+		if (needsUnlockCoreCount) {
+			unlockCoreCountPattern.prepare(unlockCoreCountPatch.find, unlockCoreCountPatch.findSize);
+			patterns[count++] = &unlockCoreCountPattern;
+		}
+		if (enableDiskArbitrationPatching) {
+			diskArbitrationPattern.prepare(diskArbitrationPatch.find, sizeof(diskArbitrationPatch.find));
+			patterns[count++] = &diskArbitrationPattern;
+		}
+
+		Matcher::calibrate(patterns, count);
+		Matcher::publish(patcher);
+	}
+
 	/**
 	 *  Default dummy BSD init policy
 	 */
@@ -487,9 +939,6 @@ struct RestrictEventsPolicy {
 
 static RestrictEventsPolicy restrictEventsPolicy;
 
-void rerouteHvVmm(KernelPatcher &patcher);
-void reroutef16c(KernelPatcher &patcher);
-
 PluginConfiguration ADDPR(config) {
 	xStringify(PRODUCT_NAME),
 	parseModuleVersion(xStringify(MODULE_VERSION)),
@@ -507,47 +956,51 @@ PluginConfiguration ADDPR(config) {
 		verboseProcessLogging = checkKernelArgument("-revproc");
 		auto di = BaseDeviceInfo::get();
 		RestrictEventsPolicy::getBlockedProcesses(&di);
+		RestrictEventsPolicy::getThrottledProcesses();
 		RestrictEventsPolicy::processEnableUIPatch(&di);
+		// Only present in Catalina and newer, older kernels have a reserved hook here.
+		if (getKernelVersion() >= KernelVersion::Catalina && ProcessThrottle::enabled())
+			restrictEventsPolicy.policyOps.mpo_proc_notify_exec_complete = RestrictEventsPolicy::policyNotifyExecComplete;
 		restrictEventsPolicy.policy.registerPolicy();
 		revassetIsSet = enableAssetPatching;
 		revsbvmmIsSet = enableSbvmmPatching;
+		revf16cIsSet = enableF16cPatching;
 
 		if ((lilu.getRunMode() & LiluAPI::RunningNormal) != 0 || (lilu.getRunMode() & LiluAPI::AllowInstallerRecovery) != 0) {
 			if (enableMemoryUiPatching | enablePciUiPatching) {
 				// Rename existing values to invalid ones to avoid matching.
 				if (strcmp(di.modelIdentifier, "MacPro7,1") == 0) {
-					// on 13.0 MacPro7,1 string literal is inlined, but "MacPro7," will do the matching.
-					modelFindPatch = "MacPro7,";
-					modelReplPatch = "HacPro7,";
-					// partial matching, thus exclude '\0'.
-					modelFindSize  = sizeof("MacPro7,") - 1;
+					modelName  = "MacPro7,";
+					modelPatch = modelPatchMacPro71;
 					DBGLOG("rev", "detected MP71");
 				} else if (strncmp(di.modelIdentifier, "MacBookAir", strlen("MacBookAir")) == 0) {
 					needsMemPatch = true;
-					modelFindPatch = "MacBookAir";
-					modelReplPatch = "HacBookAir";
-					modelFindSize  = sizeof("MacBookAir");
+					modelName  = "MacBookAir";
+					modelPatch = modelPatchMacBookAir;
 					DBGLOG("rev", "detected MBA");
 				} else if (strncmp(di.modelIdentifier, "MacBookPro10", strlen("MacBookPro10")) == 0) {
 					needsMemPatch = true;
-					modelFindPatch = "MacBookPro10";
-					modelReplPatch = "HacBookPro10";
-					modelFindSize  = sizeof("MacBookPro10");
+					modelName  = "MacBookPro10";
+					modelPatch = modelPatchMacBookPro10;
 					DBGLOG("rev", "detected MBP10");
 				}
 
-				if (modelFindPatch != nullptr) {
-					binPathSystemInformation = getKernelVersion() >= KernelVersion::Catalina ? binPathSystemInformationCatalina : binPathSystemInformationLegacy;
-				}
 			}
 
+			RestrictEventsPolicy::enableTargetBinaries();
 			needsCpuNamePatch = enableCpuNamePatching ? RestrictEventsPolicy::needsCpuNamePatch() : false;
-			if (modelFindPatch != nullptr || needsCpuNamePatch || enableDiskArbitrationPatching ||
+			if (modelName != nullptr || needsCpuNamePatch || enableDiskArbitrationPatching || ProcessThrottle::enabled() ||
 				(getKernelVersion() >= KernelVersion::Monterey ||
 				(getKernelVersion() == KernelVersion::BigSur && getKernelMinorVersion() >= 4))) {
 				lilu.onPatcherLoadForce([](void *user, KernelPatcher &patcher) {
 					if ((lilu.getRunMode() & LiluAPI::RunningNormal) != 0) {
+						if (ProcessThrottle::enabled()) RestrictEventsPolicy::solveThrottleSymbols(patcher);
 						if (needsCpuNamePatch) RestrictEventsPolicy::calculatePatchedBrandString();
+						// Expensive per-file data is precomputed in the background, not on the page fault path.
+						Precompute::init();
+						if (needsMemPatch || cpuReplSize > 0)
+							Precompute::registerJob(Precompute::SharedCache, RestrictEventsPolicy::sharedCacheJob, RestrictEventsPolicy::sharedCacheRelease);
+						RestrictEventsPolicy::prepareMatcher(patcher);
 						KernelPatcher::RouteRequest csRoute =
 						getKernelVersion() >= KernelVersion::BigSur ?
 						KernelPatcher::RouteRequest("_cs_validate_page", RestrictEventsPolicy::csValidatePageBigSur, orgCsValidateFunc) :
@@ -564,14 +1017,7 @@ PluginConfiguration ADDPR(config) {
 							SYSLOG("rev", "failed to route cs validation pages");
 					}
 					// Perform regardless of Normal vs Installer
-					if ((getKernelVersion() >= KernelVersion::Monterey ||
-						(getKernelVersion() == KernelVersion::BigSur && getKernelMinorVersion() >= 4)) &&
-						(revsbvmmIsSet || revassetIsSet))
-						rerouteHvVmm(patcher);
-					if ((enableF16cPatching) &&
-						(getKernelVersion() > KernelVersion::Ventura ||
-						(getKernelVersion() == KernelVersion::Ventura && getKernelMinorVersion() >= 4)))
-						reroutef16c(patcher);
+					installSysctlPersonalities(patcher);
 				});
 			}
 		}
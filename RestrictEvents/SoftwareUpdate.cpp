@@ -7,8 +7,10 @@
 
 #include <Headers/plugin_start.hpp>
 #include <Headers/kern_api.hpp>
+#include <Headers/kern_mach.hpp>
 #include <Headers/kern_user.hpp>
 
+#include "NameHash.hpp"
 #include "SoftwareUpdate.hpp"
 
 /**
@@ -49,6 +51,7 @@
 
 bool revassetIsSet;
 bool revsbvmmIsSet;
+bool revf16cIsSet;
 
 static struct sysctl_oid_iterator sysctl_oid_iterator_begin(struct sysctl_oid_list *l) {
 	struct sysctl_oid_iterator it = { };
@@ -143,85 +146,377 @@ static sysctl_oid *sysctl_by_name(sysctl_oid_list *sysctl_children, const char *
 	return nullptr;
 }
 
-static mach_vm_address_t org_sysctl_vmm_present;
-static int my_sysctl_vmm_present(__unused struct sysctl_oid *oidp, __unused void *arg1, int arg2, struct sysctl_req *req) {
-	char procname[64];
-	proc_name(proc_pid(req->p), procname, sizeof(procname));
-	// SYSLOG("supd", "\n\n\n\nsoftwareupdated vmm_present %d - >>> %s <<<<\n\n\n\n", arg2, procname);
-	if (revsbvmmIsSet && (
-		// Always return 1 in recovery/installers
-		(lilu.getRunMode() & LiluAPI::RunningInstallerRecovery) != 0 ||
-		// Otherwise, check if userspace OS updaters/installers
-		(
-		 strcmp(procname, "softwareupdated") == 0 ||
-		 strcmp(procname, "com.apple.Mobile") == 0 ||
-		 strcmp(procname, "osinstallersetup") == 0    // Primarily for 'Install macOS.app'
-		)
-	)) {
-		int hv_vmm_present_on = 1;
-		return SYSCTL_OUT(req, &hv_vmm_present_on, sizeof(hv_vmm_present_on));
-	} else if (revassetIsSet && (strncmp(procname, "AssetCache",  sizeof("AssetCache")-1) == 0)) {
-		int hv_vmm_present_off = 0;
-		return SYSCTL_OUT(req, &hv_vmm_present_off, sizeof(hv_vmm_present_off));
-	}
-
-	return FunctionCast(my_sysctl_vmm_present, org_sysctl_vmm_present)(oidp, arg1, arg2, req);
-}
+extern "C" void sysctl_register_oid(struct sysctl_oid *oidp);
 
+bool registerSysctl(KernelPatcher &patcher, const char *parent, sysctl_oid *oid) {
+	auto sysctl_children = reinterpret_cast<sysctl_oid_list *>(patcher.solveSymbol(KernelPatcher::KernelID, "_sysctl__children"));
+	if (!sysctl_children) {
+		SYSLOG("supd", "failed to resolve _sysctl__children");
+		patcher.clearError();
+		return false;
+	}
 
-static mach_vm_address_t org_sysctl_f16c;
-static int my_sysctl_f16c(__unused struct sysctl_oid *oidp, void *arg1, int arg2, struct sysctl_req *req) {
-	// Strip F16C bit from arg1
-	// Ref: https://github.com/apple-oss-distributions/xnu/blob/xnu-8020.101.4/bsd/kern/kern_mib.c#L935-L946
-	int mask = (uint64_t) (uintptr_t) arg1 & ~kHasF16C;
+	// WARN: sysctl_children access should be locked. Unfortunately the lock is not exported.
+	sysctl_oid *node = sysctl_by_name(sysctl_children, parent);
+	if (!node || (node->oid_kind & CTLTYPE) != CTLTYPE_NODE || node->oid_handler) {
+		SYSLOG("supd", "failed to resolve %s sysctl node", parent);
+		return false;
+	}
 
-	// Convert back
-	arg1 = (void *) (uintptr_t) mask;
-	return FunctionCast(my_sysctl_f16c, org_sysctl_f16c)(oidp, arg1, arg2, req);
+	oid->oid_parent = static_cast<sysctl_oid_list *>(node->oid_arg1);
+	sysctl_register_oid(oid);
+	DBGLOG("supd", "registered %s.%s sysctl", parent, oid->oid_name);
+	return true;
 }
 
+/**
+ *  Sysctl handler replaced in its sysctl_oid, the original is kept for restoration
+ */
+struct SysctlInterceptor {
+	sysctl_oid *oid;
+	sysctl_handler_t original;
+	sysctl_handler_t handler;
+};
+
+static constexpr size_t MaxSysctlInterceptors = 8;
+static SysctlInterceptor sysctlInterceptors[MaxSysctlInterceptors];
+static size_t sysctlInterceptorCount;
+
+// Set while the interceptors are installed, toggled through debug.revsysctl.
+static bool sysctlInterceptorsActive;
+// Set while debug.revsysctl swaps the handlers.
+static bool sysctlInterceptorsBusy;
+
+static bool swapSysctlHandler(sysctl_oid *oid, sysctl_handler_t expected, sysctl_handler_t handler) {
+	// Static sysctl_oid objects may reside in read-only kernel memory.
+	if (MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) != KERN_SUCCESS) {
+		SYSLOG("supd", "failed to obtain write permissions for %s sysctl", oid->oid_name);
+		return false;
+	}
+
+	bool swapped = __atomic_compare_exchange_n(&oid->oid_handler, &expected, handler, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
+	return swapped;
+}
+
+/**
+ *  Replace the handler of a sysctl without touching the kernel code, so only this oid is affected.
+ *  The original handler is stored before the replacement becomes visible.
+ */
+static bool interceptSysctl(KernelPatcher &patcher, const char *name, sysctl_handler_t handler, sysctl_handler_t &original) {
+	if (sysctlInterceptorCount >= MaxSysctlInterceptors) {
+		SYSLOG("supd", "too many sysctl interceptors to intercept %s", name);
+		return false;
+	}
 
-void rerouteHvVmm(KernelPatcher &patcher) {
 	auto sysctl_children = reinterpret_cast<sysctl_oid_list *>(patcher.solveSymbol(KernelPatcher::KernelID, "_sysctl__children"));
 	if (!sysctl_children) {
 		SYSLOG("supd", "failed to resolve _sysctl__children");
-		return;
+		patcher.clearError();
+		return false;
 	}
-	
+
 	// WARN: sysctl_children access should be locked. Unfortunately the lock is not exported.
-	sysctl_oid *vmm_present = sysctl_by_name(sysctl_children, "kern.hv_vmm_present");
-	if (!vmm_present) {
-		SYSLOG("supd", "failed to resolve kern.hv_vmm_present sysctl");
-		return;
+	sysctl_oid *oid = sysctl_by_name(sysctl_children, name);
+	if (!oid || !oid->oid_handler) {
+		SYSLOG("supd", "failed to resolve %s sysctl", name);
+		return false;
 	}
-	
-	org_sysctl_vmm_present = patcher.routeFunction(reinterpret_cast<mach_vm_address_t>(vmm_present->oid_handler), reinterpret_cast<mach_vm_address_t>(my_sysctl_vmm_present), true);
-	if (!org_sysctl_vmm_present) {
-		SYSLOG("supd", "failed to route kern.hv_vmm_present sysctl");
-		patcher.clearError();
-		return;
+
+	sysctl_handler_t expected = oid->oid_handler;
+	__atomic_store_n(&original, expected, __ATOMIC_RELEASE);
+	if (!swapSysctlHandler(oid, expected, handler)) {
+		SYSLOG("supd", "failed to intercept %s sysctl", name);
+		return false;
 	}
+
+	sysctlInterceptors[sysctlInterceptorCount++] = { oid, expected, handler };
+	DBGLOG("supd", "intercepted %s sysctl", name);
+	return true;
 }
 
-void reroutef16c(KernelPatcher &patcher) {
-	auto sysctl_children = reinterpret_cast<sysctl_oid_list *>(patcher.solveSymbol(KernelPatcher::KernelID, "_sysctl__children"));
-	if (!sysctl_children) {
-		SYSLOG("supd", "failed to resolve _sysctl__children");
-		return;
+/**
+ *  Install or restore the handlers of all intercepted sysctls.
+ *  Handlers still running after restoration keep calling the original ones, which remain valid.
+ */
+static void setSysctlInterceptors(bool active) {
+	for (size_t i = 0; i < sysctlInterceptorCount; i++) {
+		auto &interceptor = sysctlInterceptors[i];
+		auto expected = active ? interceptor.original : interceptor.handler;
+		auto handler = active ? interceptor.handler : interceptor.original;
+		if (!swapSysctlHandler(interceptor.oid, expected, handler))
+			SYSLOG("supd", "failed to %s %s sysctl", active ? "intercept" : "restore", interceptor.oid->oid_name);
 	}
-	
-	// WARN: sysctl_children access should be locked. Unfortunately the lock is not exported.
-	sysctl_oid *f16c = sysctl_by_name(sysctl_children, "hw.optional.f16c");
-	if (!f16c) {
-		SYSLOG("supd", "failed to resolve hw.optional.f16c sysctl");
-		return;
+
+	__atomic_store_n(&sysctlInterceptorsActive, active, __ATOMIC_RELEASE);
+	DBGLOG("supd", "%s %lu sysctls", active ? "intercepted" : "restored", sysctlInterceptorCount);
+}
+
+/**
+ *  debug.revsysctl handler, writing 0 restores the original sysctl handlers and 1 intercepts them again
+ */
+static int interceptorSysctlHandler(__unused struct sysctl_oid *oidp, __unused void *arg1, __unused int arg2, struct sysctl_req *req) {
+	int value = __atomic_load_n(&sysctlInterceptorsActive, __ATOMIC_ACQUIRE);
+	int error = SYSCTL_OUT(req, &value, sizeof(value));
+	if (error != 0 || req->newptr == 0)
+		return error;
+
+	error = SYSCTL_IN(req, &value, sizeof(value));
+	if (error != 0)
+		return error;
+	if (value != 0 && value != 1)
+		return EINVAL;
+
+	bool busy = false;
+	if (!__atomic_compare_exchange_n(&sysctlInterceptorsBusy, &busy, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return EBUSY;
+	if ((value != 0) != sysctlInterceptorsActive)
+		setSysctlInterceptors(value != 0);
+	__atomic_store_n(&sysctlInterceptorsBusy, false, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ *  Process matching kinds of a sysctl personality
+ */
+enum class PersonalityMatch : uint8_t {
+	Any,
+	Exact,
+	Prefix
+};
+
+/**
+ *  Sysctl override kinds of a sysctl personality
+ */
+enum class PersonalityAction : uint8_t {
+	// Return the value as an integer
+	Value,
+	// Clear the value bits from arg1 and call the original handler
+	ClearArg1Bits
+};
+
+/**
+ *  Per-process sysctl override, earlier rows take precedence
+ */
+struct SysctlPersonality {
+	const char *sysctl;
+	PersonalityMatch match;
+	const char *process;
+	PersonalityAction action;
+	int value;
+	const bool *enabled;
+	uint32_t runMode;
+	KernelVersion minKernel;
+	int minKernelMinor;
+};
+
+static constexpr uint32_t AnyRunMode = LiluAPI::RunningNormal | LiluAPI::RunningInstallerRecovery;
+
+static const SysctlPersonality sysctlPersonalities[] {
+	// Always report VMM in recovery/installers
+	{"kern.hv_vmm_present", PersonalityMatch::Any,    nullptr,            PersonalityAction::Value, 1, &revsbvmmIsSet, LiluAPI::RunningInstallerRecovery, KernelVersion::BigSur, 4},
+	// Otherwise, report VMM to userspace OS updaters/installers
+	{"kern.hv_vmm_present", PersonalityMatch::Exact,  "softwareupdated",  PersonalityAction::Value, 1, &revsbvmmIsSet, AnyRunMode, KernelVersion::BigSur, 4},
+	{"kern.hv_vmm_present", PersonalityMatch::Exact,  "com.apple.Mobile", PersonalityAction::Value, 1, &revsbvmmIsSet, AnyRunMode, KernelVersion::BigSur, 4},
+	// Primarily for 'Install macOS.app'
+	{"kern.hv_vmm_present", PersonalityMatch::Exact,  "osinstallersetup", PersonalityAction::Value, 1, &revsbvmmIsSet, AnyRunMode, KernelVersion::BigSur, 4},
+	{"kern.hv_vmm_present", PersonalityMatch::Prefix, "AssetCache",       PersonalityAction::Value, 0, &revassetIsSet, AnyRunMode, KernelVersion::BigSur, 4},
+	// Strip F16C bit from arg1
+	// Ref: https://github.com/apple-oss-distributions/xnu/blob/xnu-8020.101.4/bsd/kern/kern_mib.c#L935-L946
+	{"hw.optional.f16c",    PersonalityMatch::Any,    nullptr,            PersonalityAction::ClearArg1Bits, kHasF16C, &revf16cIsSet, AnyRunMode, KernelVersion::Ventura, 4},
+};
+
+static_assert(arrsize(sysctlPersonalities) < INT16_MAX, "Too many sysctl personalities");
+
+/**
+ *  Process name lookup entry, keyed by the FNV-1a hash of the matched name part
+ */
+struct PersonalityEntry {
+	uint32_t hash;
+	int16_t rule;
+	uint8_t length;
+	bool prefix;
+};
+
+/**
+ *  Intercepted sysctl with its compiled personality rules
+ */
+struct PersonalitySysctl {
+	const char *name;
+	sysctl_handler_t original;
+	int16_t anyRule;
+	// Set when a process name rule precedes anyRule.
+	bool needsName;
+	// Bit N is set when some prefix rule matches the first N characters.
+	uint64_t prefixLengths;
+	PersonalityEntry entries[16];
+};
+
+static constexpr size_t MaxPersonalitySysctls = 4;
+static PersonalitySysctl personalitySysctls[MaxPersonalitySysctls];
+static size_t personalitySysctlCount;
+
+static constexpr int16_t NoPersonality = -1;
+
+static bool insertPersonality(PersonalitySysctl &sysctl, int16_t rule) {
+	auto &row = sysctlPersonalities[rule];
+	if (row.match == PersonalityMatch::Any) {
+		if (sysctl.anyRule == NoPersonality)
+			sysctl.anyRule = rule;
+		return true;
+	}
+
+	size_t length = strlen(row.process);
+	if (length == 0 || length >= 64) {
+		SYSLOG("supd", "invalid process %s for %s personality", row.process, row.sysctl);
+		return false;
 	}
 
-	org_sysctl_f16c = patcher.routeFunction(reinterpret_cast<mach_vm_address_t>(f16c->oid_handler), reinterpret_cast<mach_vm_address_t>(my_sysctl_f16c), true);
+	uint32_t hash = NameHash::hash(row.process, length);
 
-	if (!org_sysctl_f16c) {
-		SYSLOG("supd", "failed to route hw.optional.f16c sysctl");
-		patcher.clearError();
-		return;
+	// Rows are inserted in order, so an existing anyRule always takes precedence.
+	if (sysctl.anyRule == NoPersonality)
+		sysctl.needsName = true;
+
+	bool prefix = row.match == PersonalityMatch::Prefix;
+	for (size_t i = 0; i < arrsize(sysctl.entries); i++) {
+		auto &entry = sysctl.entries[(hash + i) % arrsize(sysctl.entries)];
+		if (entry.rule == NoPersonality) {
+			entry = { hash, rule, static_cast<uint8_t>(length), prefix };
+			if (prefix)
+				sysctl.prefixLengths |= 1ULL << length;
+			return true;
+		}
+		// Earlier rows take precedence over duplicates.
+		if (entry.hash == hash && entry.length == length && entry.prefix == prefix &&
+			strncmp(sysctlPersonalities[entry.rule].process, row.process, length) == 0)
+			return true;
 	}
+
+	SYSLOG("supd", "too many personalities for %s", row.sysctl);
+	return false;
+}
+
+static int16_t probePersonality(const PersonalitySysctl &sysctl, uint32_t hash, const char *procname, size_t length, bool prefix) {
+	for (size_t i = 0; i < arrsize(sysctl.entries); i++) {
+		auto &entry = sysctl.entries[(hash + i) % arrsize(sysctl.entries)];
+		if (entry.rule == NoPersonality)
+			break;
+		if (entry.hash == hash && entry.length == length && entry.prefix == prefix &&
+			memcmp(sysctlPersonalities[entry.rule].process, procname, length) == 0)
+			return entry.rule;
+	}
+	return NoPersonality;
+}
+
+/**
+ *  Find the first personality row matching the process name in a single pass over the name
+ */
+static int16_t findPersonality(const PersonalitySysctl &sysctl, const char *procname) {
+	int16_t found = sysctl.anyRule;
+	uint32_t hash = NameHash::Offset;
+	size_t length = 0;
+
+	while (procname[length] != '\0') {
+		hash = NameHash::append(hash, procname[length]);
+		length++;
+		if (length < 64 && (sysctl.prefixLengths & (1ULL << length)) != 0) {
+			auto rule = probePersonality(sysctl, hash, procname, length, true);
+			if (rule != NoPersonality && (found == NoPersonality || rule < found))
+				found = rule;
+		}
+	}
+
+	auto rule = probePersonality(sysctl, hash, procname, length, false);
+	if (rule != NoPersonality && (found == NoPersonality || rule < found))
+		found = rule;
+	return found;
+}
+
+template <size_t Index>
+static int personalityHandler(struct sysctl_oid *oidp, void *arg1, int arg2, struct sysctl_req *req) {
+	auto &sysctl = personalitySysctls[Index];
+	auto rule = sysctl.anyRule;
+	if (sysctl.needsName) {
+		char procname[64];
+		proc_name(proc_pid(req->p), procname, sizeof(procname));
+		rule = findPersonality(sysctl, procname);
+		DBGLOG("supd", "%s personality %d for %s", sysctl.name, rule, procname);
+	}
+
+	if (rule != NoPersonality) {
+		auto &row = sysctlPersonalities[rule];
+		switch (row.action) {
+			case PersonalityAction::Value: {
+				int value = row.value;
+				return SYSCTL_OUT(req, &value, sizeof(value));
+			}
+			case PersonalityAction::ClearArg1Bits: {
+				int mask = static_cast<int>(reinterpret_cast<uintptr_t>(arg1)) & ~row.value;
+				arg1 = reinterpret_cast<void *>(static_cast<uintptr_t>(mask));
+				break;
+			}
+		}
+	}
+
+	return sysctl.original(oidp, arg1, arg2, req);
+}
+
+static constexpr sysctl_handler_t personalityHandlers[MaxPersonalitySysctls] {
+	personalityHandler<0>,
+	personalityHandler<1>,
+	personalityHandler<2>,
+	personalityHandler<3>,
+};
+
+void installSysctlPersonalities(KernelPatcher &patcher) {
+	auto runMode = lilu.getRunMode();
+	for (int16_t rule = 0; rule < static_cast<int16_t>(arrsize(sysctlPersonalities)); rule++) {
+		auto &row = sysctlPersonalities[rule];
+		if (!*row.enabled || (runMode & row.runMode) == 0 || getKernelVersion() < row.minKernel ||
+			(getKernelVersion() == row.minKernel && getKernelMinorVersion() < row.minKernelMinor))
+			continue;
+
+		PersonalitySysctl *sysctl = nullptr;
+		for (size_t i = 0; i < personalitySysctlCount; i++) {
+			if (strcmp(personalitySysctls[i].name, row.sysctl) == 0) {
+				sysctl = &personalitySysctls[i];
+				break;
+			}
+		}
+
+		if (sysctl == nullptr) {
+			if (personalitySysctlCount >= MaxPersonalitySysctls) {
+				SYSLOG("supd", "too many personality sysctls for %s", row.sysctl);
+				continue;
+			}
+			sysctl = &personalitySysctls[personalitySysctlCount++];
+			sysctl->name = row.sysctl;
+			sysctl->anyRule = NoPersonality;
+			for (auto &entry : sysctl->entries)
+				entry.rule = NoPersonality;
+		}
+
+		insertPersonality(*sysctl, rule);
+	}
+
+	// Rules are complete before any handler becomes visible.
+	for (size_t i = 0; i < personalitySysctlCount; i++)
+		interceptSysctl(patcher, personalitySysctls[i].name, personalityHandlers[i], personalitySysctls[i].original);
+
+	if (sysctlInterceptorCount == 0)
+		return;
+
+	sysctlInterceptorsActive = true;
+	static sysctl_oid interceptorOid {
+		.oid_number = OID_AUTO,
+		.oid_kind = static_cast<int>(CTLTYPE_INT | CTLFLAG_RW | CTLFLAG_LOCKED | CTLFLAG_OID2),
+		.oid_name = "revsysctl",
+		.oid_handler = interceptorSysctlHandler,
+		.oid_fmt = "I",
+		.oid_descr = "RestrictEvents sysctl interception",
+		.oid_version = SYSCTL_OID_VERSION
+	};
+
+	registerSysctl(patcher, "debug", &interceptorOid);
 }
@@ -21,7 +21,17 @@
 #define CTLTYPE_OPAQUE      5               /* name describes a structure */
 #define CTLTYPE_STRUCT      CTLTYPE_OPAQUE  /* name describes a structure */
 
+#define CTLFLAG_RD      0x80000000      /* Allow reads of variable */
+#define CTLFLAG_WR      0x40000000      /* Allow writes to the variable */
+#define CTLFLAG_RW      (CTLFLAG_RD|CTLFLAG_WR)
+#define CTLFLAG_OID2    0x00400000      /* struct sysctl_oid has version info */
+#define CTLFLAG_LOCKED  0x00800000      /* node will handle locking itself */
+
+#define OID_AUTO        (-1)
+#define SYSCTL_OID_VERSION  1
+
 #define SYSCTL_OUT(r, p, l) (r->oldfunc)(r, p, l)
+#define SYSCTL_IN(r, p, l) (r->newfunc)(r, p, l)
 
 #define OID_MUTABLE_ANCHOR    (INT_MIN)
 
@@ -69,5 +79,16 @@ SLIST_HEAD(sysctl_oid_list, sysctl_oid);
 
 extern bool revassetIsSet;
 extern bool revsbvmmIsSet;
+extern bool revf16cIsSet;
+
+/**
+ *  Register a sysctl under an existing parent node
+ */
+bool registerSysctl(KernelPatcher &patcher, const char *parent, sysctl_oid *oid);
+
+/**
+ *  Intercept the sysctls with enabled per-process personalities
+ */
+void installSysctlPersonalities(KernelPatcher &patcher);
 
 #endif /* SoftwareUpdate_h */
@@ -0,0 +1,150 @@
+//
+//  SparsePatch.hpp
+//  RestrictEvents
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef SparsePatch_h
+#define SparsePatch_h
+
+#include <Headers/kern_api.hpp>
+
+#include "Matcher.hpp"
+
+/**
+ *  Single byte edit relative to the start of the matched pattern
+ */
+struct PatchEdit {
+	uint8_t offset;
+	uint8_t value;
+};
+
+/**
+ *  Find pattern with the byte edits turning it into the replacement.
+ *  Built at compile time from find/replace pairs with makeSparsePatch.
+ */
+template <size_t FindSize, size_t MaxEdits>
+struct SparsePatch {
+	static_assert(FindSize > 0 && FindSize <= UINT8_MAX + 1, "Sparse patch offsets are 8-bit");
+
+	uint8_t find[FindSize];
+	PatchEdit edits[MaxEdits];
+	size_t editCount;
+};
+
+/**
+ *  Size-erased view of a SparsePatch used at runtime
+ */
+struct SparsePatchRef {
+	const uint8_t *find;
+	size_t findSize;
+	const PatchEdit *edits;
+	size_t editCount;
+
+	template <size_t FindSize, size_t MaxEdits>
+	constexpr SparsePatchRef(const SparsePatch<FindSize, MaxEdits> &patch) :
+		find(patch.find), findSize(FindSize), edits(patch.edits), editCount(patch.editCount) {}
+
+	constexpr SparsePatchRef(const uint8_t *find, size_t findSize, const PatchEdit *edits, size_t editCount) :
+		find(find), findSize(findSize), edits(edits), editCount(editCount) {}
+};
+
+/**
+ *  Derive the sparse form of a find/replace pair, where replace overwrites the first ReplSize bytes of find.
+ */
+template <size_t FindSize, size_t ReplSize, typename T>
+constexpr SparsePatch<FindSize, ReplSize> makeSparsePatch(const T *find, const T *repl) {
+	static_assert(ReplSize <= FindSize, "Replacement must not exceed the find pattern");
+	SparsePatch<FindSize, ReplSize> patch {};
+	for (size_t i = 0; i < FindSize; i++)
+		patch.find[i] = static_cast<uint8_t>(find[i]);
+	for (size_t i = 0; i < ReplSize; i++) {
+		if (find[i] != repl[i]) {
+			patch.edits[patch.editCount].offset = static_cast<uint8_t>(i);
+			patch.edits[patch.editCount].value = static_cast<uint8_t>(repl[i]);
+			patch.editCount++;
+		}
+	}
+	return patch;
+}
+
+template <typename T, size_t FindSize, size_t ReplSize>
+constexpr SparsePatch<FindSize, ReplSize> makeSparsePatch(const T (&find)[FindSize], const T (&repl)[ReplSize]) {
+	return makeSparsePatch<FindSize, ReplSize>(&find[0], &repl[0]);
+}
+
+/**
+ *  Check that applying the sparse patch to its find pattern gives the same bytes as copying the replacement over it,
+ *  and that every edit is needed.
+ */
+template <size_t FindSize, size_t MaxEdits, typename T>
+constexpr bool sparsePatchEquivalent(const SparsePatch<FindSize, MaxEdits> &patch, const T *find, const T *repl, size_t replSize) {
+	uint8_t patched[FindSize] {};
+	for (size_t i = 0; i < FindSize; i++) {
+		if (patch.find[i] != static_cast<uint8_t>(find[i]))
+			return false;
+		patched[i] = patch.find[i];
+	}
+	for (size_t i = 0; i < patch.editCount; i++) {
+		auto &edit = patch.edits[i];
+		if (edit.offset >= replSize || patched[edit.offset] == edit.value)
+			return false;
+		patched[edit.offset] = edit.value;
+	}
+	for (size_t i = 0; i < FindSize; i++) {
+		if (patched[i] != static_cast<uint8_t>(i < replSize ? repl[i] : find[i]))
+			return false;
+	}
+	return true;
+}
+
+template <size_t FindSize, size_t MaxEdits, typename T, size_t N, size_t M>
+constexpr bool sparsePatchEquivalent(const SparsePatch<FindSize, MaxEdits> &patch, const T (&find)[N], const T (&repl)[M]) {
+	return N == FindSize && sparsePatchEquivalent(patch, &find[0], &repl[0], M);
+}
+
+/**
+ *  Write to validated pages, which may be mapped read-only in the kernel, same as with KernelPatcher::findAndReplace
+ *
+ *  @param what   written data name for the error message
+ *  @param write  function performing the write
+ *
+ *  @return true if write permissions were obtained and the write was performed
+ */
+template <typename Write>
+static inline bool writeValidatedPage(const char *what, Write write) {
+	if (MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) != KERN_SUCCESS) {
+		SYSLOG("rev", "failed to obtain write permissions for %s", what);
+		return false;
+	}
+
+	write();
+	MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
+	return true;
+}
+
+/**
+ *  Apply a sparse patch to the first match in the buffer, writing only the edited bytes
+ *
+ *  @param data     buffer to patch
+ *  @param size     buffer size
+ *  @param patch    patch to apply
+ *  @param pattern  patch find pattern prepared for Matcher
+ *
+ *  @return true if the pattern was found and patched
+ */
+static inline bool applySparsePatch(void *data, size_t size, const SparsePatchRef &patch, const MatcherPattern &pattern) {
+	auto match = Matcher::find(data, size, pattern);
+	if (LIKELY(match == nullptr))
+		return false;
+
+	// Every edit changes a byte of the find pattern, so an already patched page never matches.
+	auto bytes = static_cast<uint8_t *>(const_cast<void *>(match));
+	return writeValidatedPage("sparse patch", [&]() {
+		for (size_t i = 0; i < patch.editCount; i++)
+			bytes[patch.edits[i].offset] = patch.edits[i].value;
+	});
+}
+
+#endif /* SparsePatch_h */
@@ -0,0 +1,159 @@
+//
+//  DyldSharedCacheReader.cpp
+//  RestrictEvents host tests
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+//
+// Prints the file ranges RestrictEvents would scan for an image in an extracted dyld shared cache,
+// following the same steps as the kext shared cache job.
+//
+// DyldSharedCacheReader <main cache path> [image install path]
+//
+// With --verify every cache file is scanned in full for all AppleSystemInfo find patterns,
+// failing when a match lies in a page outside the AppleSystemInfo ranges, which the kext would skip.
+//
+// DyldSharedCacheReader --verify <main cache path>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../RestrictEvents/DyldSharedCache.cpp"
+#include "PatchScan.hpp"
+
+static bool readFile(void *context, uint64_t offset, void *buffer, size_t size) {
+	auto file = static_cast<FILE *>(context);
+	return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0 && fread(buffer, 1, size, file) == size;
+}
+
+/**
+ *  Print every find pattern match in a cache file and whether the kext scans it
+ *
+ *  @return true if no match lies outside the ranges
+ */
+static bool verifyRanges(const char *path, FILE *file, const DyldSharedCache::FileRanges &ranges) {
+	if (fseeko(file, 0, SEEK_END) != 0) {
+		fprintf(stderr, "%s: cannot read\n", path);
+		return false;
+	}
+
+	auto outside = scanPatchPatterns(readFile, file, static_cast<uint64_t>(ftello(file)), ranges,
+		[](const PatchPattern &pattern, uint64_t offset, bool scanned) {
+			printf("  %s at 0x%llx%s\n", pattern.name, static_cast<unsigned long long>(offset), scanned ? "" : " OUTSIDE");
+		});
+
+	if (outside < 0) {
+		fprintf(stderr, "%s: cannot read\n", path);
+		return false;
+	}
+	if (outside > 0) {
+		fprintf(stderr, "%s: %ld matches outside the ranges\n", path, outside);
+		return false;
+	}
+	return true;
+}
+
+/**
+ *  Print the image ranges of one cache file
+ */
+static bool printRanges(const char *path, const DyldSharedCache::Range *segments, size_t count, bool verify) {
+	auto file = fopen(path, "rb");
+	if (file == nullptr) {
+		fprintf(stderr, "%s: cannot open\n", path);
+		return false;
+	}
+
+	DyldSharedCache::Header header;
+	bool parsed = DyldSharedCache::parseHeader(readFile, file, header);
+	if (parsed) {
+		DyldSharedCache::FileRanges ranges;
+		DyldSharedCache::mapSegments(header, segments, count, ranges);
+		printf("%s: %zu mappings, %zu ranges\n", path, header.mappingCount, ranges.count);
+		for (size_t i = 0; i < ranges.count; i++)
+			printf("  0x%llx-0x%llx\n", static_cast<unsigned long long>(ranges.ranges[i].start),
+				   static_cast<unsigned long long>(ranges.ranges[i].end));
+		if (verify)
+			parsed = verifyRanges(path, file, ranges);
+	} else {
+		fprintf(stderr, "%s: invalid cache header\n", path);
+	}
+
+	fclose(file);
+	return parsed;
+}
+
+int main(int argc, char **argv) {
+	bool verify = argc > 1 && strcmp(argv[1], "--verify") == 0;
+	if (verify ? argc != 3 : (argc < 2 || argc > 3)) {
+		fprintf(stderr, "usage: %s <main cache path> [image install path]\n", argv[0]);
+		fprintf(stderr, "       %s --verify <main cache path>\n", argv[0]);
+		return 2;
+	}
+
+	const char *mainPath = argv[verify ? 2 : 1];
+	const char *image = !verify && argc > 2 ? argv[2] : binPathAppleSystemInfo;
+	auto mainFile = fopen(mainPath, "rb");
+	if (mainFile == nullptr) {
+		fprintf(stderr, "%s: cannot open\n", mainPath);
+		return 1;
+	}
+
+	DyldSharedCache::Header header;
+	if (!DyldSharedCache::parseHeader(readFile, mainFile, header)) {
+		fprintf(stderr, "%s: invalid cache header\n", mainPath);
+		return 1;
+	}
+	printf("%s: %u images, %u sub caches\n", mainPath, header.imagesCount, header.subCacheCount);
+
+	auto scan = new DyldSharedCache::ImageScan;
+	uint64_t address = 0;
+	bool found = DyldSharedCache::findImage(readFile, mainFile, header, image, address, *scan);
+	delete scan;
+	if (!found) {
+		fprintf(stderr, "%s: image %s not found\n", mainPath, image);
+		return 1;
+	}
+	printf("%s at 0x%llx\n", image, static_cast<unsigned long long>(address));
+
+	DyldSharedCache::Range segments[DyldSharedCache::MaxSegments];
+	size_t count = 0;
+	found = DyldSharedCache::readSegments(readFile, mainFile, header, address, segments, count);
+
+	char subPath[1024];
+	for (uint32_t i = 0; !found && i < header.subCacheCount; i++) {
+		char suffix[DyldSharedCache::MaxSuffix];
+		if (!DyldSharedCache::subCacheSuffix(readFile, mainFile, header, i, suffix))
+			break;
+		snprintf(subPath, sizeof(subPath), "%s%s", mainPath, suffix);
+		auto subFile = fopen(subPath, "rb");
+		if (subFile == nullptr)
+			continue;
+		DyldSharedCache::Header subHeader;
+		found = DyldSharedCache::parseHeader(readFile, subFile, subHeader) &&
+			DyldSharedCache::readSegments(readFile, subFile, subHeader, address, segments, count);
+		fclose(subFile);
+	}
+
+	if (!found) {
+		fprintf(stderr, "%s: segments of %s not found\n", mainPath, image);
+		return 1;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		printf("segment 0x%llx-0x%llx\n", static_cast<unsigned long long>(segments[i].start),
+			   static_cast<unsigned long long>(segments[i].end));
+
+	bool parsed = printRanges(mainPath, segments, count, verify);
+	for (uint32_t i = 0; i < header.subCacheCount; i++) {
+		char suffix[DyldSharedCache::MaxSuffix];
+		if (!DyldSharedCache::subCacheSuffix(readFile, mainFile, header, i, suffix))
+			break;
+		snprintf(subPath, sizeof(subPath), "%s%s", mainPath, suffix);
+		parsed = printRanges(subPath, segments, count, verify) && parsed;
+	}
+
+	fclose(mainFile);
+	return parsed ? 0 : 1;
+}
@@ -0,0 +1,297 @@
+//
+//  DyldSharedCacheTests.cpp
+//  RestrictEvents host tests
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <stdlib.h>
+
+#include "HostTest.hpp"
+
+#include "../RestrictEvents/DyldSharedCache.cpp"
+#include "PatchScan.hpp"
+
+/**
+ *  In-memory cache file built by the tests
+ */
+struct CacheFile {
+	uint8_t *data;
+	size_t size;
+	size_t reads;
+
+	explicit CacheFile(size_t size) : data(static_cast<uint8_t *>(calloc(size, 1))), size(size), reads(0) {}
+	~CacheFile() { free(data); }
+
+	template <typename T>
+	void put(size_t offset, T value) {
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	void putString(size_t offset, const char *string) {
+		memcpy(&data[offset], string, strlen(string) + 1);
+	}
+
+	void putHeader(uint32_t mappingOffset, uint32_t mappingCount) {
+		memcpy(data, "dyld_v1  x86_64h", CacheMagicSize);
+		put<uint32_t>(CacheMappingOffset, mappingOffset);
+		put<uint32_t>(CacheMappingCount, mappingCount);
+	}
+
+	void putMapping(uint32_t mappingOffset, size_t index, uint64_t address, uint64_t size, uint64_t fileOffset) {
+		size_t offset = mappingOffset + index * MappingInfoSize;
+		put<uint64_t>(offset, address);
+		put<uint64_t>(offset + 8, size);
+		put<uint64_t>(offset + 16, fileOffset);
+	}
+
+	void putMachHeader(size_t offset, const char *const *names, const uint64_t *addresses, const uint64_t *sizes, uint32_t count) {
+		put<uint32_t>(offset, MachHeader64Magic);
+		put<uint32_t>(offset + 16, count);
+		put<uint32_t>(offset + 20, static_cast<uint32_t>(count * SegmentCommand64MinSize));
+		for (uint32_t i = 0; i < count; i++) {
+			size_t command = offset + MachHeader64Size + i * SegmentCommand64MinSize;
+			put<uint32_t>(command, LoadCommandSegment64);
+			put<uint32_t>(command + 4, static_cast<uint32_t>(SegmentCommand64MinSize));
+			strncpy(reinterpret_cast<char *>(&data[command + 8]), names[i], 16);
+			put<uint64_t>(command + 24, addresses[i]);
+			put<uint64_t>(command + 32, sizes[i]);
+		}
+	}
+
+	static bool read(void *context, uint64_t offset, void *buffer, size_t size) {
+		auto file = static_cast<CacheFile *>(context);
+		file->reads++;
+		if (offset > file->size || size > file->size - offset)
+			return false;
+		memcpy(buffer, &file->data[offset], size);
+		return true;
+	}
+};
+
+static constexpr uint64_t TextAddress = 0x7FF800000000;
+static constexpr uint64_t DataAddress = 0x7FF900000000;
+
+/**
+ *  Build a main cache with text and data mappings and an image list of imageCount entries,
+ *  where AppleSystemInfo is the image at target with __TEXT, __DATA_CONST and __LINKEDIT segments.
+ */
+static void buildMainCache(CacheFile &file, uint32_t imageCount, uint32_t target, size_t pathsOffset) {
+	file.putHeader(0x200, 2);
+	file.put<uint32_t>(CacheImagesOffset, 0x300);
+	file.put<uint32_t>(CacheImagesCount, imageCount);
+	file.putMapping(0x200, 0, TextAddress, 0x10000, 0);
+	file.putMapping(0x200, 1, DataAddress, 0x4000, 0x10000);
+
+	size_t pathOffset = pathsOffset;
+	for (uint32_t i = 0; i < imageCount; i++) {
+		char path[MaxImagePath];
+		if (i == target)
+			snprintf(path, sizeof(path), "%s", binPathAppleSystemInfo);
+		else
+			snprintf(path, sizeof(path), "/System/Library/PrivateFrameworks/Image%u.framework/Versions/A/Image%u", i, i);
+		file.put<uint64_t>(0x300 + i * DyldSharedCache::ImageInfoSize, i == target ? TextAddress + 0x8000 : TextAddress + 0x1000);
+		file.put<uint32_t>(0x300 + i * DyldSharedCache::ImageInfoSize + ImageInfoPathOffset, static_cast<uint32_t>(pathOffset));
+		file.putString(pathOffset, path);
+		pathOffset += strlen(path) + 1;
+	}
+
+	const char *names[] {"__TEXT", "__DATA_CONST", "__LINKEDIT"};
+	uint64_t addresses[] {TextAddress + 0x8000, DataAddress + 0x1000, DataAddress + 0x3000};
+	uint64_t sizes[] {0x2000, 0x800, 0x1000};
+	file.putMachHeader(0x8000, names, addresses, sizes, 3);
+}
+
+static void testParseMainCache() {
+	CacheFile file(0x14000);
+	buildMainCache(file, 3, 1, 0x1000);
+
+	DyldSharedCache::Header header;
+	CHECK(DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+	CHECK_EQ(header.mappingCount, 2);
+	CHECK_EQ(header.imagesCount, 3);
+	CHECK_EQ(header.subCacheCount, 0);
+
+	auto scan = new DyldSharedCache::ImageScan;
+	uint64_t address = 0;
+	CHECK(DyldSharedCache::findImage(CacheFile::read, &file, header, binPathAppleSystemInfo, address, *scan));
+	CHECK_EQ(address, TextAddress + 0x8000);
+	CHECK(!DyldSharedCache::findImage(CacheFile::read, &file, header, "/usr/lib/libMissing.dylib", address, *scan));
+	delete scan;
+
+	DyldSharedCache::Range segments[DyldSharedCache::MaxSegments];
+	size_t count = 0;
+	CHECK(DyldSharedCache::readSegments(CacheFile::read, &file, header, TextAddress + 0x8000, segments, count));
+	// __LINKEDIT is shared by all images and skipped.
+	CHECK_EQ(count, 2);
+	CHECK_EQ(segments[0].start, TextAddress + 0x8000);
+	CHECK_EQ(segments[1].start, DataAddress + 0x1000);
+
+	DyldSharedCache::FileRanges ranges;
+	DyldSharedCache::mapSegments(header, segments, count, ranges);
+	CHECK_EQ(ranges.count, 2);
+	CHECK_EQ(ranges.ranges[0].start, 0x8000);
+	CHECK_EQ(ranges.ranges[0].end, 0xA000);
+	CHECK_EQ(ranges.ranges[1].start, 0x11000);
+	CHECK_EQ(ranges.ranges[1].end, 0x11800);
+
+	CHECK(ranges.intersects(0x9000, 0x1000));
+	CHECK(ranges.intersects(0x7800, 0x1000));
+	CHECK(!ranges.intersects(0xA000, 0x1000));
+	CHECK(!ranges.intersects(0x7000, 0x1000));
+	CHECK(ranges.intersects(0x11000, 0x1000));
+}
+
+static void testBatchedImageList() {
+	// Enough images for several batches and path windows, with AppleSystemInfo near the end.
+	constexpr uint32_t imageCount = 600;
+	CacheFile file(0x80000);
+	buildMainCache(file, imageCount, imageCount - 3, 0x20000);
+
+	DyldSharedCache::Header header;
+	CHECK(DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+
+	auto scan = new DyldSharedCache::ImageScan;
+	uint64_t address = 0;
+	file.reads = 0;
+	CHECK(DyldSharedCache::findImage(CacheFile::read, &file, header, binPathAppleSystemInfo, address, *scan));
+	CHECK_EQ(address, TextAddress + 0x8000);
+	// One read per image batch plus one per path window instead of one per image.
+	CHECK(file.reads <= (imageCount + DyldSharedCache::ImageBatch - 1) / DyldSharedCache::ImageBatch + 10);
+	delete scan;
+}
+
+static void testPathWindowAtEndOfFile() {
+	// Paths end right at the end of the file, so the full window cannot be read there.
+	constexpr uint32_t imageCount = 4;
+	CacheFile file(0x12000);
+	buildMainCache(file, imageCount, imageCount - 1, 0x11800);
+	size_t end = 0x11800;
+	for (uint32_t i = 0; i < imageCount; i++)
+		end += strlen(reinterpret_cast<const char *>(&file.data[end])) + 1;
+	file.size = end;
+
+	DyldSharedCache::Header header;
+	CHECK(DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+
+	auto scan = new DyldSharedCache::ImageScan;
+	uint64_t address = 0;
+	CHECK(DyldSharedCache::findImage(CacheFile::read, &file, header, binPathAppleSystemInfo, address, *scan));
+	CHECK_EQ(address, TextAddress + 0x8000);
+	delete scan;
+}
+
+static void testSubCaches() {
+	CacheFile file(0x14000);
+	buildMainCache(file, 3, 1, 0x1000);
+	// Sub cache fields are only valid when the mappings follow them.
+	file.putHeader(0x1D0, 2);
+	file.putMapping(0x1D0, 0, TextAddress, 0x10000, 0);
+	file.putMapping(0x1D0, 1, DataAddress, 0x4000, 0x10000);
+	file.put<uint32_t>(CacheSubCacheArrayOffset, 0x900);
+	file.put<uint32_t>(CacheSubCacheArrayCount, 2);
+	file.putString(0x900 + SubCacheEntryV2Suffix, ".01");
+	file.putString(0x900 + SubCacheEntryV2Size + SubCacheEntryV2Suffix, ".dylddata");
+
+	DyldSharedCache::Header header;
+	CHECK(DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+	CHECK_EQ(header.subCacheCount, 2);
+	CHECK(header.subCacheSuffixes);
+
+	char suffix[DyldSharedCache::MaxSuffix];
+	CHECK(DyldSharedCache::subCacheSuffix(CacheFile::read, &file, header, 0, suffix));
+	CHECK(strcmp(suffix, ".01") == 0);
+	CHECK(DyldSharedCache::subCacheSuffix(CacheFile::read, &file, header, 1, suffix));
+	CHECK(strcmp(suffix, ".dylddata") == 0);
+	CHECK(!DyldSharedCache::subCacheSuffix(CacheFile::read, &file, header, 2, suffix));
+
+	// Older caches use the 1-based index.
+	header.subCacheCount = 12;
+	header.subCacheSuffixes = false;
+	CHECK(DyldSharedCache::subCacheSuffix(CacheFile::read, &file, header, 10, suffix));
+	CHECK(strcmp(suffix, ".11") == 0);
+
+	// A sub cache mapping only data does not contain the text segment.
+	DyldSharedCache::Header subHeader {};
+	subHeader.mappingCount = 1;
+	subHeader.mappings[0] = {DataAddress, 0x4000, 0x4000};
+	DyldSharedCache::Range segments[] {{TextAddress + 0x8000, TextAddress + 0xA000}, {DataAddress + 0x1000, DataAddress + 0x1800}};
+	DyldSharedCache::FileRanges ranges;
+	DyldSharedCache::mapSegments(subHeader, segments, 2, ranges);
+	CHECK_EQ(ranges.count, 1);
+	CHECK_EQ(ranges.ranges[0].start, 0x5000);
+	CHECK_EQ(ranges.ranges[0].end, 0x5800);
+}
+
+static void testPatchScan() {
+	CacheFile file(0x14000);
+	buildMainCache(file, 3, 1, 0x1000);
+	memcpy(&file.data[0x9100], memFindPatch, sizeof(memFindPatch));
+	memcpy(&file.data[0x11200], cpuName8CoreXeonW, sizeof(cpuName8CoreXeonW));
+
+	DyldSharedCache::Header header;
+	CHECK(DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+	DyldSharedCache::Range segments[DyldSharedCache::MaxSegments];
+	size_t count = 0;
+	CHECK(DyldSharedCache::readSegments(CacheFile::read, &file, header, TextAddress + 0x8000, segments, count));
+	DyldSharedCache::FileRanges ranges;
+	DyldSharedCache::mapSegments(header, segments, count, ranges);
+
+	size_t hits = 0;
+	auto countHits = [&](const PatchPattern &, uint64_t, bool) { hits++; };
+	CHECK_EQ(scanPatchPatterns(CacheFile::read, &file, file.size, ranges, countHits), 0);
+	CHECK_EQ(hits, 2);
+
+	// A match in another image is reported, including when its page starts before the ranges.
+	memcpy(&file.data[0x4000], findUnlockCoreCount, sizeof(findUnlockCoreCount));
+	memcpy(&file.data[0x7FF0], cpuNameCoreI5, sizeof(cpuNameCoreI5));
+	hits = 0;
+	uint64_t outsideOffsets[2] {};
+	size_t outside = 0;
+	CHECK_EQ(scanPatchPatterns(CacheFile::read, &file, file.size, ranges, [&](const PatchPattern &, uint64_t offset, bool scanned) {
+		hits++;
+		if (!scanned && outside < 2)
+			outsideOffsets[outside++] = offset;
+	}), 2);
+	CHECK_EQ(hits, 4);
+	CHECK_EQ(outside, 2);
+	CHECK(outsideOffsets[0] == 0x7FF0 || outsideOffsets[1] == 0x7FF0);
+	CHECK(outsideOffsets[0] == 0x4000 || outsideOffsets[1] == 0x4000);
+
+	file.size = 0;
+	CHECK_EQ(scanPatchPatterns(CacheFile::read, &file, 0x100, ranges, countHits), -1);
+
+	// Matches across and right before a chunk boundary are reported once.
+	CacheFile large(ScanChunkSize + 0x1000);
+	memcpy(&large.data[ScanChunkSize - 10], memFindPatch, sizeof(memFindPatch));
+	memcpy(&large.data[ScanChunkSize - 40], cpuNameCoreI5, sizeof(cpuNameCoreI5));
+	DyldSharedCache::FileRanges none {};
+	hits = 0;
+	CHECK_EQ(scanPatchPatterns(CacheFile::read, &large, large.size, none, countHits), 2);
+	CHECK_EQ(hits, 2);
+}
+
+static void testInvalidFiles() {
+	CacheFile file(0x1000);
+	DyldSharedCache::Header header;
+	CHECK(!DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+
+	file.putHeader(0x200, 0);
+	CHECK(!DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+	file.putHeader(0x200, DyldSharedCache::MaxMappings + 1);
+	CHECK(!DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+
+	file.size = 0x100;
+	file.putHeader(0x200, 1);
+	CHECK(!DyldSharedCache::parseHeader(CacheFile::read, &file, header));
+}
+
+int main() {
+	testParseMainCache();
+	testBatchedImageList();
+	testPathWindowAtEndOfFile();
+	testSubCaches();
+	testPatchScan();
+	testInvalidFiles();
+	return hostTestResult("DyldSharedCacheTests");
+}
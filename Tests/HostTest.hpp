@@ -0,0 +1,39 @@
+//
+//  HostTest.hpp
+//  RestrictEvents host tests
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef HostTest_h
+#define HostTest_h
+
+#include <stdio.h>
+
+/**
+ *  Failed check counter, returned from main
+ */
+static int hostTestFailures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		hostTestFailures++; \
+	} \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+	long long actualValue = static_cast<long long>(actual); \
+	long long expectedValue = static_cast<long long>(expected); \
+	if (actualValue != expectedValue) { \
+		fprintf(stderr, "%s:%d: check failed: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, actualValue, expectedValue); \
+		hostTestFailures++; \
+	} \
+} while (0)
+
+static inline int hostTestResult(const char *name) {
+	printf("%s: %s\n", name, hostTestFailures == 0 ? "passed" : "FAILED");
+	return hostTestFailures == 0 ? 0 : 1;
+}
+
+#endif /* HostTest_h */
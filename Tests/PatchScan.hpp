@@ -0,0 +1,116 @@
+//
+//  PatchScan.hpp
+//  RestrictEvents host tests
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef PatchScan_h
+#define PatchScan_h
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../RestrictEvents/AppleSystemInfoPatches.hpp"
+#include "../RestrictEvents/DyldSharedCache.hpp"
+
+/**
+ *  AppleSystemInfo find pattern searched in shared cache files
+ */
+struct PatchPattern {
+	const char *name;
+	const void *find;
+	size_t size;
+};
+
+#define PATCH_PATTERN(name, find) {name, find, sizeof(find)}
+
+/**
+ *  Every find pattern the kext may search in the shared cache, including all CPU name variants
+ */
+static const PatchPattern appleSystemInfoPatterns[] {
+	PATCH_PATTERN("model whitelist", memFindPatch),
+	PATCH_PATTERN("Intel Core i5", cpuNameCoreI5),
+	PATCH_PATTERN("Dual-Core Intel Core i5", cpuNameDualCoreI5),
+	PATCH_PATTERN("Quad-Core Intel Core i5", cpuNameQuadCoreI5),
+	PATCH_PATTERN("6-Core Intel Core i5", cpuName6CoreI5),
+	PATCH_PATTERN("8-Core Intel Xeon W", cpuName8CoreXeonW),
+	PATCH_PATTERN("10-Core Intel Xeon W", cpuName10CoreXeonW),
+	PATCH_PATTERN("12-Core Intel Xeon W", cpuName12CoreXeonW),
+	PATCH_PATTERN("14-Core Intel Xeon W", cpuName14CoreXeonW),
+	PATCH_PATTERN("16-Core Intel Xeon W", cpuName16CoreXeonW),
+	PATCH_PATTERN("18-Core Intel Xeon W", cpuName18CoreXeonW),
+	PATCH_PATTERN("24-Core Intel Xeon W", cpuName24CoreXeonW),
+	PATCH_PATTERN("28-Core Intel Xeon W", cpuName28CoreXeonW),
+	PATCH_PATTERN("core count", findUnlockCoreCount),
+};
+
+#undef PATCH_PATTERN
+
+/**
+ *  Validated page size the kext checks against the ranges
+ */
+static constexpr uint64_t ScanPageSize = 4096;
+static constexpr size_t ScanChunkSize = 16 * 1024 * 1024;
+static constexpr size_t ScanOverlap = 64;
+
+/**
+ *  Scan a whole cache file for every AppleSystemInfo find pattern
+ *
+ *  @param reader    cache file reader
+ *  @param context   reader context
+ *  @param fileSize  cache file size
+ *  @param ranges    AppleSystemInfo ranges of this file
+ *  @param hit       called with the pattern, its file offset and whether the kext scans its page
+ *
+ *  @return number of matches in pages outside the ranges, or -1 when the file cannot be read
+ */
+template <typename Hit>
+static long scanPatchPatterns(DyldSharedCache::Reader reader, void *context, uint64_t fileSize, const DyldSharedCache::FileRanges &ranges, Hit hit) {
+	for (auto &pattern : appleSystemInfoPatterns)
+		if (pattern.size > ScanOverlap)
+			return -1;
+
+	auto chunk = static_cast<uint8_t *>(malloc(ScanChunkSize + ScanOverlap));
+	if (chunk == nullptr)
+		return -1;
+
+	// Each chunk repeats the tail of the previous one, so matches crossing chunk boundaries are seen once.
+	long outside = 0;
+	size_t kept = 0;
+	for (uint64_t offset = 0; offset < fileSize; ) {
+		size_t size = fileSize - offset < ScanChunkSize ? static_cast<size_t>(fileSize - offset) : ScanChunkSize;
+		if (!reader(context, offset, &chunk[kept], size)) {
+			free(chunk);
+			return -1;
+		}
+
+		uint64_t base = offset - kept;
+		size_t total = kept + size;
+		for (auto &pattern : appleSystemInfoPatterns) {
+			for (size_t i = 0; i + pattern.size <= total; i++) {
+				auto match = static_cast<const uint8_t *>(memmem(&chunk[i], total - i, pattern.find, pattern.size));
+				if (match == nullptr)
+					break;
+				i = static_cast<size_t>(match - chunk);
+				// Matches ending in the kept tail were reported with the previous chunk.
+				if (i + pattern.size <= kept)
+					continue;
+				uint64_t matchOffset = base + i;
+				bool scanned = ranges.intersects(matchOffset & ~(ScanPageSize - 1), ScanPageSize);
+				if (!scanned)
+					outside++;
+				hit(pattern, matchOffset, scanned);
+			}
+		}
+
+		kept = total < ScanOverlap ? total : ScanOverlap;
+		memmove(chunk, &chunk[total - kept], kept);
+		offset += size;
+	}
+
+	free(chunk);
+	return outside;
+}
+
+#endif /* PatchScan_h */
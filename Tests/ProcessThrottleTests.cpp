@@ -0,0 +1,73 @@
+//
+//  ProcessThrottleTests.cpp
+//  RestrictEvents host tests
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include "HostTest.hpp"
+
+#include "../RestrictEvents/ProcessThrottle.cpp"
+
+static bool isBackground(const ProcessThrottle::PolicySet &set) {
+	bool darwinBg = false;
+	bool ioThrottle = false;
+	for (size_t i = 0; i < set.count; i++) {
+		auto &policy = set.policies[i];
+		CHECK_EQ(policy.category, TaskPolicyExternal);
+		if (policy.flavor == TaskPolicyDarwinBg && policy.value == 1)
+			darwinBg = true;
+		if (policy.flavor == TaskPolicyIoPol && policy.value == IoPolThrottle)
+			ioThrottle = true;
+	}
+	return set.count == 2 && darwinBg && ioThrottle;
+}
+
+static void testDisabled() {
+	ProcessThrottle::configure("none");
+	CHECK(!ProcessThrottle::enabled());
+	CHECK_EQ(ProcessThrottle::policiesFor("mediaanalysisd").count, 0);
+	CHECK_EQ(ProcessThrottle::policiesFor("").count, 0);
+}
+
+static void testOptions() {
+	ProcessThrottle::configure("media");
+	CHECK(ProcessThrottle::enabled());
+	CHECK(isBackground(ProcessThrottle::policiesFor("mediaanalysisd")));
+	CHECK_EQ(ProcessThrottle::policiesFor("photoanalysisd").count, 0);
+	CHECK_EQ(ProcessThrottle::policiesFor("mds_stores").count, 0);
+
+	ProcessThrottle::configure("photo,mds");
+	CHECK_EQ(ProcessThrottle::policiesFor("mediaanalysisd").count, 0);
+	CHECK(isBackground(ProcessThrottle::policiesFor("photoanalysisd")));
+	CHECK(isBackground(ProcessThrottle::policiesFor("mds_stores")));
+
+	ProcessThrottle::configure("media,photo,mds");
+	CHECK(isBackground(ProcessThrottle::policiesFor("mediaanalysisd")));
+	CHECK(isBackground(ProcessThrottle::policiesFor("photoanalysisd")));
+	CHECK(isBackground(ProcessThrottle::policiesFor("mds_stores")));
+
+	// Reconfiguring drops the previous selection.
+	ProcessThrottle::configure("none");
+	CHECK(!ProcessThrottle::enabled());
+	CHECK_EQ(ProcessThrottle::policiesFor("mds_stores").count, 0);
+}
+
+static void testExactNames() {
+	ProcessThrottle::configure("media,photo,mds");
+	// Only exact process names match, not related daemons sharing a prefix.
+	CHECK_EQ(ProcessThrottle::policiesFor("mds").count, 0);
+	CHECK_EQ(ProcessThrottle::policiesFor("mds_store").count, 0);
+	CHECK_EQ(ProcessThrottle::policiesFor("mds_stores2").count, 0);
+	CHECK_EQ(ProcessThrottle::policiesFor("mediaanalysisd-access").count, 0);
+	CHECK_EQ(ProcessThrottle::policiesFor("MediaAnalysisD").count, 0);
+	CHECK_EQ(ProcessThrottle::policiesFor("launchd").count, 0);
+	CHECK_EQ(ProcessThrottle::policiesFor("kernel_task").count, 0);
+}
+
+int main() {
+	testDisabled();
+	testOptions();
+	testExactNames();
+	return hostTestResult("ProcessThrottleTests");
+}
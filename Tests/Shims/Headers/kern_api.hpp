@@ -0,0 +1,123 @@
+//
+//  kern_api.hpp
+//  RestrictEvents host tests
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef kern_api_shim_h
+#define kern_api_shim_h
+
+/**
+ *  Minimal userspace replacement of the Lilu and kernel interfaces used by the sources under test.
+ *  Behaviour is controlled by the test through the definitions it provides.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#ifndef __unused
+#define __unused __attribute__((unused))
+#endif
+
+#define LIKELY(x)   __builtin_expect(!!(x), 1)
+#define UNLIKELY(x) __builtin_expect(!!(x), 0)
+
+#define arrsize(array) (sizeof(array) / sizeof((array)[0]))
+
+#define SYSLOG(module, str, ...) fprintf(stderr, "%s: " str "\n", module, ## __VA_ARGS__)
+#define DBGLOG(module, str, ...) do { } while (0)
+
+typedef int kern_return_t;
+#define KERN_SUCCESS 0
+
+typedef uint64_t mach_vm_address_t;
+typedef uint64_t user_addr_t;
+
+struct proc;
+typedef struct proc *proc_t;
+
+struct IOSimpleLock;
+
+enum KernelVersion {
+	SnowLeopard   = 10,
+	Lion          = 11,
+	MountainLion  = 12,
+	Mavericks     = 13,
+	Yosemite      = 14,
+	ElCapitan     = 15,
+	Sierra        = 16,
+	HighSierra    = 17,
+	Mojave        = 18,
+	Catalina      = 19,
+	BigSur        = 20,
+	Monterey      = 21,
+	Ventura       = 22,
+	Sonoma        = 23,
+	Sequoia       = 24,
+};
+
+typedef int KernelMinorVersion;
+
+KernelVersion getKernelVersion();
+KernelMinorVersion getKernelMinorVersion();
+
+class KernelPatcher {
+public:
+	static constexpr size_t KernelID = 0;
+	static IOSimpleLock *kernelWriteLock;
+
+	mach_vm_address_t solveSymbol(size_t id, const char *symbol);
+	void clearError();
+};
+
+class MachInfo {
+public:
+	static kern_return_t setKernelWriting(bool enable, IOSimpleLock *lock);
+};
+
+class LiluAPI {
+public:
+	enum RunningMode : uint32_t {
+		RunningNormal            = 1,
+		RunningInstallerRecovery = 2,
+		RunningSafeMode          = 4,
+	};
+
+	uint32_t getRunMode();
+};
+
+extern LiluAPI lilu;
+
+int proc_pid(proc_t p);
+void proc_name(int pid, char *buf, int size);
+
+// glibc may or may not declare strlcpy, so avoid clashing with it.
+static inline size_t shim_strlcpy(char *dst, const char *src, size_t size) {
+	size_t length = strlen(src);
+	if (size > 0) {
+		size_t copy = length < size - 1 ? length : size - 1;
+		memcpy(dst, src, copy);
+		dst[copy] = '\0';
+	}
+	return length;
+}
+
+#undef strlcpy
+#define strlcpy shim_strlcpy
+
+// Lilu overload searching for the first len bytes of needle.
+static inline const char *strstr(const char *stack, const char *needle, size_t len) {
+	if (len == 0)
+		len = strlen(needle);
+	for (; *stack != '\0'; stack++)
+		if (strncmp(stack, needle, len) == 0)
+			return stack;
+	return nullptr;
+}
+
+#endif /* kern_api_shim_h */
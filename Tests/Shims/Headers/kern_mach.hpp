@@ -0,0 +1,8 @@
+//
+//  kern_mach.hpp
+//  RestrictEvents host tests
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include <Headers/kern_api.hpp>
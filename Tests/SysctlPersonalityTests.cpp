@@ -0,0 +1,301 @@
+//
+//  SysctlPersonalityTests.cpp
+//  RestrictEvents host tests
+//
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#include "HostTest.hpp"
+
+// Static helpers are exercised directly.
+#include "../RestrictEvents/SoftwareUpdate.cpp"
+
+LiluAPI lilu;
+IOSimpleLock *KernelPatcher::kernelWriteLock;
+
+static uint32_t runMode = LiluAPI::RunningNormal;
+static KernelVersion kernelVersion = KernelVersion::Sonoma;
+static KernelMinorVersion kernelMinorVersion = 0;
+static sysctl_oid_list *sysctlChildren;
+static const char *currentProcess;
+static size_t procNameCalls;
+
+uint32_t LiluAPI::getRunMode() { return runMode; }
+KernelVersion getKernelVersion() { return kernelVersion; }
+KernelMinorVersion getKernelMinorVersion() { return kernelMinorVersion; }
+mach_vm_address_t KernelPatcher::solveSymbol(size_t, const char *) { return reinterpret_cast<mach_vm_address_t>(sysctlChildren); }
+void KernelPatcher::clearError() {}
+kern_return_t MachInfo::setKernelWriting(bool, IOSimpleLock *) { return KERN_SUCCESS; }
+int proc_pid(proc_t) { return 1; }
+static sysctl_oid *registeredOid;
+extern "C" void sysctl_register_oid(sysctl_oid *oid) { registeredOid = oid; }
+
+void proc_name(int, char *buf, int size) {
+	procNameCalls++;
+	strlcpy(buf, currentProcess, size);
+}
+
+/**
+ *  Mock sysctl tree with kern.hv_vmm_present and hw.optional.f16c backed by originalHandler
+ */
+static sysctl_oid_list rootList, kernList, hwList, optionalList, debugList;
+static sysctl_oid kernNode, hwNode, optionalNode, debugNode, vmmOid, f16cOid;
+
+static size_t originalCalls;
+static void *originalArg1;
+
+static int originalHandler(sysctl_oid *, void *arg1, int, sysctl_req *) {
+	originalCalls++;
+	originalArg1 = arg1;
+	return 0;
+}
+
+static int outValue;
+static size_t outCalls;
+
+static int mockOldFunc(sysctl_req *, const void *p, size_t l) {
+	outCalls++;
+	if (l == sizeof(outValue))
+		memcpy(&outValue, p, l);
+	return 0;
+}
+
+static void addOid(sysctl_oid_list &list, sysctl_oid &oid, const char *name, sysctl_oid_list *children) {
+	oid = {};
+	oid.oid_name = name;
+	if (children != nullptr) {
+		oid.oid_kind = CTLTYPE_NODE;
+		oid.oid_arg1 = children;
+	} else {
+		oid.oid_kind = CTLTYPE_INT;
+		oid.oid_handler = originalHandler;
+	}
+	SLIST_INSERT_HEAD(&list, &oid, oid_link);
+}
+
+static void setup(uint32_t mode, bool sbvmm, bool asset, bool f16c, KernelVersion version = KernelVersion::Sonoma, KernelMinorVersion minor = 0) {
+	SLIST_INIT(&rootList);
+	SLIST_INIT(&kernList);
+	SLIST_INIT(&hwList);
+	SLIST_INIT(&optionalList);
+	SLIST_INIT(&debugList);
+	addOid(rootList, kernNode, "kern", &kernList);
+	addOid(rootList, hwNode, "hw", &hwList);
+	addOid(hwList, optionalNode, "optional", &optionalList);
+	addOid(rootList, debugNode, "debug", &debugList);
+	addOid(kernList, vmmOid, "hv_vmm_present", nullptr);
+	addOid(optionalList, f16cOid, "f16c", nullptr);
+	sysctlChildren = &rootList;
+
+	memset(personalitySysctls, 0, sizeof(personalitySysctls));
+	personalitySysctlCount = 0;
+	sysctlInterceptorCount = 0;
+	sysctlInterceptorsActive = false;
+	registeredOid = nullptr;
+
+	runMode = mode;
+	kernelVersion = version;
+	kernelMinorVersion = minor;
+	revsbvmmIsSet = sbvmm;
+	revassetIsSet = asset;
+	revf16cIsSet = f16c;
+
+	KernelPatcher patcher;
+	installSysctlPersonalities(patcher);
+}
+
+/**
+ *  Query a sysctl as the given process
+ *
+ *  @return value written through SYSCTL_OUT or -1 when the original handler ran
+ */
+static int query(sysctl_oid &oid, const char *process, void *arg1 = nullptr) {
+	currentProcess = process;
+	originalCalls = 0;
+	originalArg1 = nullptr;
+	outCalls = 0;
+	outValue = -1;
+
+	sysctl_req req {};
+	req.oldfunc = mockOldFunc;
+	oid.oid_handler(&oid, arg1, 0, &req);
+
+	if (originalCalls > 0) {
+		CHECK_EQ(outCalls, 0);
+		return -1;
+	}
+	CHECK_EQ(outCalls, 1);
+	return outValue;
+}
+
+static void testNormalMode() {
+	setup(LiluAPI::RunningNormal, true, true, false);
+	CHECK(vmmOid.oid_handler != originalHandler);
+	CHECK(f16cOid.oid_handler == originalHandler);
+
+	CHECK_EQ(query(vmmOid, "softwareupdated"), 1);
+	CHECK_EQ(query(vmmOid, "com.apple.Mobile"), 1);
+	CHECK_EQ(query(vmmOid, "osinstallersetup"), 1);
+	CHECK_EQ(query(vmmOid, "launchd"), -1);
+	// Exact rows do not match prefixes or extensions of the name.
+	CHECK_EQ(query(vmmOid, "softwareupdate"), -1);
+	CHECK_EQ(query(vmmOid, "softwareupdatedx"), -1);
+	CHECK_EQ(query(vmmOid, ""), -1);
+}
+
+static void testAssetCachePrefix() {
+	setup(LiluAPI::RunningNormal, true, true, false);
+	// The prefix row matches the bare prefix and any longer name.
+	CHECK_EQ(query(vmmOid, "AssetCache"), 0);
+	CHECK_EQ(query(vmmOid, "AssetCacheLocatorService"), 0);
+	CHECK_EQ(query(vmmOid, "AssetCacheManagerService"), 0);
+	CHECK_EQ(query(vmmOid, "AssetCach"), -1);
+	CHECK_EQ(query(vmmOid, "assetcache"), -1);
+	// Exact rows are unaffected by the prefix row.
+	CHECK_EQ(query(vmmOid, "softwareupdated"), 1);
+
+	// Without revasset the prefix row is absent and the name falls through.
+	setup(LiluAPI::RunningNormal, true, false, false);
+	CHECK_EQ(query(vmmOid, "AssetCacheLocatorService"), -1);
+	CHECK_EQ(query(vmmOid, "softwareupdated"), 1);
+
+	// Only revasset still needs the interceptor.
+	setup(LiluAPI::RunningNormal, false, true, false);
+	CHECK_EQ(query(vmmOid, "AssetCacheLocatorService"), 0);
+	CHECK_EQ(query(vmmOid, "softwareupdated"), -1);
+}
+
+static void testRecoveryAnyRow() {
+	setup(LiluAPI::RunningInstallerRecovery, true, true, false);
+	// The leading Any row wins over every named row, including the AssetCache override to 0.
+	procNameCalls = 0;
+	CHECK_EQ(query(vmmOid, "launchd"), 1);
+	CHECK_EQ(query(vmmOid, "softwareupdated"), 1);
+	CHECK_EQ(query(vmmOid, "AssetCacheLocatorService"), 1);
+	// No process name is needed once an Any row precedes all named rows.
+	CHECK_EQ(procNameCalls, 0);
+	CHECK(!personalitySysctls[0].needsName);
+
+	setup(LiluAPI::RunningNormal, true, true, false);
+	procNameCalls = 0;
+	CHECK_EQ(query(vmmOid, "launchd"), -1);
+	CHECK_EQ(procNameCalls, 1);
+}
+
+static void testKernelVersionGate() {
+	setup(LiluAPI::RunningNormal, true, true, true, KernelVersion::BigSur, 3);
+	CHECK(vmmOid.oid_handler == originalHandler);
+	CHECK(f16cOid.oid_handler == originalHandler);
+	CHECK_EQ(personalitySysctlCount, 0);
+
+	setup(LiluAPI::RunningNormal, true, true, true, KernelVersion::BigSur, 4);
+	CHECK(vmmOid.oid_handler != originalHandler);
+	CHECK(f16cOid.oid_handler == originalHandler);
+
+	setup(LiluAPI::RunningNormal, true, true, true, KernelVersion::Ventura, 4);
+	CHECK(vmmOid.oid_handler != originalHandler);
+	CHECK(f16cOid.oid_handler != originalHandler);
+}
+
+static void testF16cClearArg1Bits() {
+	setup(LiluAPI::RunningNormal, false, false, true);
+	CHECK(vmmOid.oid_handler == originalHandler);
+	CHECK(f16cOid.oid_handler != originalHandler);
+
+	// arg1 carries the capability bits, only F16C is stripped before the original handler runs.
+	uintptr_t caps = kHasF16C | 0x1 | 0x40000;
+	CHECK_EQ(query(f16cOid, "launchd", reinterpret_cast<void *>(caps)), -1);
+	CHECK_EQ(reinterpret_cast<uintptr_t>(originalArg1), 0x1 | 0x40000);
+
+	CHECK_EQ(query(f16cOid, "launchd", reinterpret_cast<void *>(static_cast<uintptr_t>(0x1))), -1);
+	CHECK_EQ(reinterpret_cast<uintptr_t>(originalArg1), 0x1);
+
+	// Both sysctls are intercepted independently.
+	setup(LiluAPI::RunningNormal, true, false, true);
+	CHECK_EQ(personalitySysctlCount, 2);
+	CHECK_EQ(query(vmmOid, "softwareupdated"), 1);
+	CHECK_EQ(query(f16cOid, "softwareupdated", reinterpret_cast<void *>(static_cast<uintptr_t>(kHasF16C))), -1);
+	CHECK_EQ(reinterpret_cast<uintptr_t>(originalArg1), 0);
+}
+
+static void testFindPersonality() {
+	setup(LiluAPI::RunningNormal, true, true, false);
+	auto &sysctl = personalitySysctls[0];
+	CHECK(strcmp(sysctl.name, "kern.hv_vmm_present") == 0);
+	CHECK_EQ(findPersonality(sysctl, "softwareupdated"), 1);
+	CHECK_EQ(findPersonality(sysctl, "com.apple.Mobile"), 2);
+	CHECK_EQ(findPersonality(sysctl, "osinstallersetup"), 3);
+	CHECK_EQ(findPersonality(sysctl, "AssetCacheTetheratorService"), 4);
+	CHECK_EQ(findPersonality(sysctl, "mds"), NoPersonality);
+
+	// Duplicate rows keep the earliest one.
+	CHECK(insertPersonality(sysctl, 1));
+	CHECK_EQ(findPersonality(sysctl, "softwareupdated"), 1);
+}
+
+static int newValue;
+
+static int mockNewFunc(sysctl_req *, void *p, size_t l) {
+	if (l != sizeof(newValue))
+		return EINVAL;
+	memcpy(p, &newValue, l);
+	return 0;
+}
+
+/**
+ *  Write debug.revsysctl
+ *
+ *  @return handler error
+ */
+static int setInterceptors(int value) {
+	newValue = value;
+	sysctl_req req {};
+	req.oldfunc = mockOldFunc;
+	req.newfunc = mockNewFunc;
+	req.newptr = 1;
+	return registeredOid->oid_handler(registeredOid, nullptr, 0, &req);
+}
+
+static void testRestoreInterceptors() {
+	setup(LiluAPI::RunningNormal, true, false, true);
+	CHECK(registeredOid != nullptr);
+	if (registeredOid == nullptr)
+		return;
+	CHECK(strcmp(registeredOid->oid_name, "revsysctl") == 0);
+	CHECK(registeredOid->oid_parent == &debugList);
+	CHECK(vmmOid.oid_handler != originalHandler);
+	CHECK(f16cOid.oid_handler != originalHandler);
+
+	// Writing 0 puts the original handlers back.
+	CHECK_EQ(setInterceptors(0), 0);
+	CHECK(vmmOid.oid_handler == originalHandler);
+	CHECK(f16cOid.oid_handler == originalHandler);
+	CHECK_EQ(query(vmmOid, "softwareupdated"), -1);
+	CHECK_EQ(query(*registeredOid, "sysctl"), 0);
+	CHECK_EQ(setInterceptors(0), 0);
+	CHECK(vmmOid.oid_handler == originalHandler);
+
+	// Writing 1 intercepts them again with the same rules.
+	CHECK_EQ(setInterceptors(1), 0);
+	CHECK(vmmOid.oid_handler != originalHandler);
+	CHECK_EQ(query(vmmOid, "softwareupdated"), 1);
+	CHECK_EQ(query(*registeredOid, "sysctl"), 1);
+
+	CHECK_EQ(setInterceptors(2), EINVAL);
+	CHECK(vmmOid.oid_handler != originalHandler);
+
+	// Nothing is registered without interceptors.
+	setup(LiluAPI::RunningNormal, false, false, false);
+	CHECK(registeredOid == nullptr);
+}
+
+int main() {
+	testNormalMode();
+	testAssetCachePrefix();
+	testRecoveryAnyRow();
+	testKernelVersionGate();
+	testF16cClearArg1Bits();
+	testFindPersonality();
+	testRestoreInterceptors();
+	return hostTestResult("SysctlPersonalityTests");
+}